@@ -37,6 +37,16 @@ public:
 	// Assignment operator
 	void operator=(const BigInteger &x);
 
+	// Move constructor and move assignment (see BigUnsigned.hh)
+	BigInteger(BigInteger &&x) noexcept
+			: sign(x.sign), mag(std::move(x.mag)) {
+		x.sign = zero;
+	}
+	void operator=(BigInteger &&x) noexcept {
+		std::swap(sign, x.sign);
+		mag.swap(x.mag);
+	}
+
 	// Constructor that copies from a given array of blocks with a sign.
 	BigInteger(const Blk *b, Index blen, Sign s);
 
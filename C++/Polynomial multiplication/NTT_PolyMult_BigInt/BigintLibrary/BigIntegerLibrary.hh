@@ -1,5 +1,6 @@
 // This header file includes all of the library header files.
 
+#include "ScratchArena.hh"
 #include "NumberlikeArray.hh"
 #include "BigUnsigned.hh"
 #include "BigInteger.hh"
@@ -110,19 +110,25 @@ BigUnsigned::CmpRes BigUnsigned::compareTo(const BigUnsigned &x) const {
  * right-to-left.  At some point I might determine which ones don't need the
  * copy, but my reasoning would need to be verified very carefully.  For now
  * I'll leave in the copy.
+ *
+ * `add' and `subtract' are the exceptions: they read block i of each operand
+ * before writing block i of the result and never look back, so they run in
+ * place when *this is exactly one of the operands.  (The rvalue operators in
+ * BigUnsigned.hh depend on this.)  The temporary is now swapped in rather
+ * than copied.
  */
 #define DTRT_ALIASED(cond, op) \
 	if (cond) { \
 		BigUnsigned tmpThis; \
 		tmpThis.op; \
-		*this = tmpThis; \
+		swap(tmpThis); \
 		return; \
 	}
 
 
 
 void BigUnsigned::add(const BigUnsigned &a, const BigUnsigned &b) {
-	DTRT_ALIASED(this == &a || this == &b, add(a, b));
+	DTRT_ALIASED(this == &a && this == &b, add(a, b));
 	// If one argument is zero, copy the other.
 	if (a.len == 0) {
 		operator =(b);
@@ -145,11 +151,17 @@ void BigUnsigned::add(const BigUnsigned &a, const BigUnsigned &b) {
 		a2 = &b;
 		b2 = &a;
 	}
+	/* Save the input lengths: if we are running in place, one of them is
+	 * our own len, which is about to change. */
+	Index a2len = a2->len, b2len = b2->len;
 	// Set prelimiary length and make room in this BigUnsigned
-	len = a2->len + 1;
-	allocate(len);
+	if (this == &a || this == &b)
+		allocateAndCopy(a2len + 1);
+	else
+		allocate(a2len + 1);
+	len = a2len + 1;
 	// For each block index that is present in both inputs...
-	for (i = 0, carryIn = false; i < b2->len; i++) {
+	for (i = 0, carryIn = false; i < b2len; i++) {
 		// Add input blocks
 		temp = a2->blk[i] + b2->blk[i];
 		// If a rollover occurred, the result is less than either input.
@@ -165,14 +177,14 @@ void BigUnsigned::add(const BigUnsigned &a, const BigUnsigned &b) {
 	}
 	// If there is a carry left over, increase blocks until
 	// one does not roll over.
-	for (; i < a2->len && carryIn; i++) {
+	for (; i < a2len && carryIn; i++) {
 		temp = a2->blk[i] + 1;
 		carryIn = (temp == 0);
 		blk[i] = temp;
 	}
 	// If the carry was resolved but the larger number
 	// still has blocks, copy them over.
-	for (; i < a2->len; i++)
+	for (; i < a2len; i++)
 		blk[i] = a2->blk[i];
 	// Set the extra block if there's still a carry, decrease length otherwise
 	if (carryIn)
@@ -182,7 +194,7 @@ void BigUnsigned::add(const BigUnsigned &a, const BigUnsigned &b) {
 }
 
 void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
-	DTRT_ALIASED(this == &a || this == &b, subtract(a, b));
+	DTRT_ALIASED(this == &a && this == &b, subtract(a, b));
 	if (b.len == 0) {
 		// If b is zero, copy a.
 		operator =(a);
@@ -195,11 +207,16 @@ void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
 	bool borrowIn, borrowOut;
 	Blk temp;
 	Index i;
+	// Save the input lengths in case one of them is our own len (see `add').
+	Index alen = a.len, blen = b.len;
 	// Set preliminary length and make room
-	len = a.len;
-	allocate(len);
+	if (this == &b)
+		allocateAndCopy(alen);
+	else
+		allocate(alen);
+	len = alen;
 	// For each block index that is present in both inputs...
-	for (i = 0, borrowIn = false; i < b.len; i++) {
+	for (i = 0, borrowIn = false; i < blen; i++) {
 		temp = a.blk[i] - b.blk[i];
 		// If a reverse rollover occurred,
 		// the result is greater than the block from a.
@@ -214,7 +231,7 @@ void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
 	}
 	// If there is a borrow left over, decrease blocks until
 	// one does not reverse rollover.
-	for (; i < a.len && borrowIn; i++) {
+	for (; i < alen && borrowIn; i++) {
 		borrowIn = (a.blk[i] == 0);
 		blk[i] = a.blk[i] - 1;
 	}
@@ -226,7 +243,7 @@ void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
 		throw "BigUnsigned::subtract: Negative result in unsigned calculation";
 	} else
 		// Copy over the rest of the blocks
-		for (; i < a.len; i++)
+		for (; i < alen; i++)
 			blk[i] = a.blk[i];
 	// Zap leading zeros
 	zapLeadingZeros();
@@ -265,6 +282,11 @@ void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
  * and subtraction rather than single-block multiplication and division,
  * the innermost loops of all four routines are very similar.  Study one
  * of them and all will become clear.
+ *
+ * When BIGUNSIGNED_DBLK is defined (see BigUnsigned.hh), `b_0' and `c_0'
+ * are just DBlk multiplication and division, and `multiply' and
+ * `divideWithRemainder' use Knuth's Algorithms 4.3.1 M and D instead.  The
+ * bit-shifting versions remain for compilers without a double-width type.
  */
 
 /*
@@ -311,6 +333,32 @@ void BigUnsigned::multiply(const BigUnsigned &a, const BigUnsigned &b) {
 	 * For each 1-bit of `a' (say the `i2'th bit of block `i'):
 	 *    Add `b << (i blocks and i2 bits)' to *this.
 	 */
+#ifdef BIGUNSIGNED_DBLK
+	/*
+	 * Knuth's Algorithm M: for each block of `a', add that block times `b'
+	 * to *this, shifted left by the block's index.  A DBlk holds
+	 * x * y + z + c for any blocks x, y, z and c without overflow.
+	 */
+	Index i, j;
+	len = a.len + b.len;
+	allocate(len);
+	for (i = 0; i < len; i++)
+		blk[i] = 0;
+	for (i = 0; i < a.len; i++) {
+		Blk ai = a.blk[i], carry = 0;
+		if (ai == 0)
+			continue;
+		for (j = 0; j < b.len; j++) {
+			DBlk t = DBlk(ai) * b.blk[j] + blk[i + j] + carry;
+			blk[i + j] = Blk(t);
+			carry = Blk(t >> N);
+		}
+		blk[i + b.len] = carry;
+	}
+	// Zap possible leading zero
+	if (blk[len - 1] == 0)
+		len--;
+#else
 	// Variables for the calculation
 	Index i, j, k;
 	unsigned int i2;
@@ -366,6 +414,7 @@ void BigUnsigned::multiply(const BigUnsigned &a, const BigUnsigned &b) {
 	// Zap possible leading zero
 	if (blk[len - 1] == 0)
 		len--;
+#endif
 }
 
 /*
@@ -420,6 +469,11 @@ void BigUnsigned::divideWithRemainder(const BigUnsigned &b, BigUnsigned &q) {
 
 	// At this point we know (*this).len >= b.len > 0.  (Whew!)
 
+#ifdef BIGUNSIGNED_DBLK
+	divideWithRemainderKnuth(b, &q);
+	return;
+#endif
+
 	/*
 	 * Overall method:
 	 *
@@ -463,8 +517,11 @@ void BigUnsigned::divideWithRemainder(const BigUnsigned &b, BigUnsigned &q) {
 	len++;
 	blk[origLen] = 0; // Zero the added block.
 
-	// subtractBuf holds part of the result of a subtraction; see above.
-	Blk *subtractBuf = new Blk[len];
+	/* subtractBuf holds part of the result of a subtraction; see above.
+	 * Small divisions (the common case of reducing a product by a modulus
+	 * of a few blocks) use a buffer on the stack instead of the heap. */
+	Blk subtractStackBuf[8];
+	Blk *subtractBuf = (len <= 8) ? subtractStackBuf : newBlocks(len);
 
 	// Set preliminary length for quotient and make room
 	q.len = origLen - b.len + 1;
@@ -534,7 +591,231 @@ void BigUnsigned::divideWithRemainder(const BigUnsigned &b, BigUnsigned &q) {
 	zapLeadingZeros();
 	// Deallocate subtractBuf.
 	// (Thanks to Brad Spencer for noticing my accidental omission of this!)
-	delete [] subtractBuf;
+	if (subtractBuf != subtractStackBuf)
+		deleteBlocks(subtractBuf);
+}
+
+#ifdef BIGUNSIGNED_DBLK
+/*
+ * Knuth's Algorithm D, used by divideWithRemainder once it has dealt with
+ * aliasing and the trivial cases, so here (*this).len >= b.len > 0 and q is
+ * distinct from both *this and b.  If q is NULL only the remainder is
+ * computed (see the modular operations below).
+ *
+ * A one-block divisor needs just one pass of DBlk divisions from the top
+ * block down.  Otherwise both numbers are shifted left until the divisor's
+ * top bit is set (step D1); each quotient block is then estimated from the
+ * top two blocks of the running remainder and the top block of the divisor,
+ * which is at most 2 too big (D3), and the estimate times the divisor is
+ * subtracted, adding the divisor back in the rare case that it was still 1
+ * too big (D4-D6).  The remainder is shifted back at the end (D8).
+ */
+void BigUnsigned::divideWithRemainderKnuth(const BigUnsigned &b, BigUnsigned *q) {
+	Index i, j;
+	if (b.len == 1) {
+		Blk d = b.blk[0], r = 0;
+		if (q != NULL) {
+			q->len = len;
+			q->allocate(q->len);
+		}
+		for (i = len; i > 0; ) {
+			i--;
+			DBlk cur = (DBlk(r) << N) | blk[i];
+			if (q != NULL)
+				q->blk[i] = Blk(cur / d);
+			r = Blk(cur % d);
+		}
+		if (q != NULL)
+			q->zapLeadingZeros();
+		blk[0] = r;
+		len = (r == 0) ? 0 : 1;
+		return;
+	}
+
+	Index n = b.len, m = len - b.len;
+	// D1: normalize.  u gets an extra top block; both live in one buffer.
+	unsigned int s = 0;
+	for (Blk top = b.blk[n - 1]; (top & (Blk(1) << (N - 1))) == 0; top <<= 1)
+		s++;
+	Blk stackBuf[24];
+	Blk *u = (len + 1 + n <= 24) ? stackBuf : newBlocks(len + 1 + n);
+	Blk *v = u + len + 1;
+	for (i = 0; i < n; i++)
+		v[i] = getShiftedBlock(b, i, s);
+	for (i = 0; i <= len; i++)
+		u[i] = getShiftedBlock(*this, i, s);
+
+	if (q != NULL) {
+		q->len = m + 1;
+		q->allocate(q->len);
+	}
+	// D2-D7: one quotient block per iteration, most significant first.
+	for (j = m + 1; j > 0; ) {
+		j--;
+		// D3: estimate the quotient block and correct it if it is too big.
+		DBlk num = (DBlk(u[j + n]) << N) | u[j + n - 1];
+		DBlk qhat = num / v[n - 1], rhat = num % v[n - 1];
+		while ((qhat >> N) != 0
+				|| qhat * v[n - 2] > ((rhat << N) | u[j + n - 2])) {
+			qhat--;
+			rhat += v[n - 1];
+			if ((rhat >> N) != 0)
+				break;
+		}
+		// D4: subtract qhat * v from the current part of u.
+		Blk mulCarry = 0, borrow = 0;
+		for (i = 0; i <= n; i++) {
+			Blk sub;
+			if (i < n) {
+				DBlk p = qhat * v[i] + mulCarry;
+				sub = Blk(p);
+				mulCarry = Blk(p >> N);
+			} else
+				sub = mulCarry;
+			Blk t = u[i + j] - sub;
+			Blk borrowOut = (t > u[i + j]);
+			if (borrow) {
+				borrowOut |= (t == 0);
+				t--;
+			}
+			u[i + j] = t;
+			borrow = borrowOut;
+		}
+		// D5-D6: if that went negative, qhat was one too big; add v back.
+		if (borrow)
+			qhat--;
+		if (q != NULL)
+			q->blk[j] = Blk(qhat);
+		if (borrow) {
+			Blk carry = 0;
+			for (i = 0; i < n; i++) {
+				DBlk t = DBlk(u[i + j]) + v[i] + carry;
+				u[i + j] = Blk(t);
+				carry = Blk(t >> N);
+			}
+			u[j + n] += carry;
+		}
+	}
+	// Zap possible leading zero in quotient
+	if (q != NULL)
+		q->zapLeadingZeros();
+
+	// D8: unnormalize the remainder, which is in the low n blocks of u.
+	for (i = 0; i < n; i++)
+		blk[i] = (s == 0) ? u[i] : ((u[i] >> s) | (u[i + 1] << (N - s)));
+	len = n;
+	zapLeadingZeros();
+	if (u != stackBuf)
+		deleteBlocks(u);
+}
+#endif
+
+/* MODULAR OPERATIONS
+ * The general versions are the copy-less multiply/add/subtract followed by a
+ * remainder-only division in place.  With a one-block modulus (the RNS
+ * channels) the operands are first reduced to one block each, so the whole
+ * operation is a few DBlk multiplications and divisions. */
+
+void BigUnsigned::reduce(const BigUnsigned &m) {
+	if (m.len == 0 || len < m.len)
+		return;
+#ifdef BIGUNSIGNED_DBLK
+	divideWithRemainderKnuth(m, NULL);
+#else
+	BigUnsigned q;
+	divideWithRemainder(m, q);
+#endif
+}
+
+#ifdef BIGUNSIGNED_DBLK
+BigUnsigned::Blk BigUnsigned::reduceBlock(const BigUnsigned &x, Blk m) {
+	if (x.len == 0)
+		return 0;
+	if (x.len == 1 && x.blk[0] < m)
+		return x.blk[0];
+	Blk r = 0;
+	for (Index i = x.len; i > 0; ) {
+		i--;
+		r = Blk(((DBlk(r) << N) | x.blk[i]) % m);
+	}
+	return r;
+}
+#endif
+
+void BigUnsigned::mulmod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m) {
+#ifdef BIGUNSIGNED_DBLK
+	if (m.len == 1) {
+		Blk d = m.blk[0];
+		Blk ra = reduceBlock(a, d), rb = reduceBlock(b, d);
+		setSingleBlock(Blk(DBlk(ra) * rb % d));
+		return;
+	}
+#endif
+	DTRT_ALIASED(this == &m, mulmod(a, b, m));
+	multiply(a, b);
+	reduce(m);
+}
+
+void BigUnsigned::muladdmod(const BigUnsigned &a, const BigUnsigned &b,
+		const BigUnsigned &d, const BigUnsigned &m) {
+#ifdef BIGUNSIGNED_DBLK
+	// (m - 1)^2 + (m - 1) still fits in a DBlk.
+	if (m.len == 1) {
+		Blk mod = m.blk[0];
+		Blk ra = reduceBlock(a, mod), rb = reduceBlock(b, mod), rd = reduceBlock(d, mod);
+		setSingleBlock(Blk((DBlk(ra) * rb + rd) % mod));
+		return;
+	}
+#endif
+	DTRT_ALIASED(this == &d || this == &m, muladdmod(a, b, d, m));
+	multiply(a, b);
+	add(*this, d);
+	reduce(m);
+}
+
+void BigUnsigned::addmod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m) {
+#ifdef BIGUNSIGNED_DBLK
+	if (m.len == 1) {
+		Blk d = m.blk[0];
+		DBlk s = DBlk(reduceBlock(a, d)) + reduceBlock(b, d);
+		setSingleBlock(Blk((s >= d) ? s - d : s));
+		return;
+	}
+#endif
+	DTRT_ALIASED(this == &m, addmod(a, b, m));
+	// Reduced operands need at most one subtraction of m.
+	bool reduced = (a < m && b < m);
+	add(a, b);
+	if (!reduced)
+		reduce(m);
+	else if (!(*this < m))
+		subtract(*this, m);
+}
+
+void BigUnsigned::submod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m) {
+#ifdef BIGUNSIGNED_DBLK
+	if (m.len == 1) {
+		Blk d = m.blk[0];
+		Blk ra = reduceBlock(a, d), rb = reduceBlock(b, d);
+		setSingleBlock((ra >= rb) ? ra - rb : d - (rb - ra));
+		return;
+	}
+#endif
+	DTRT_ALIASED(this == &m, submod(a, b, m));
+	if (m.len != 0 && !(a < m && b < m)) {
+		BigUnsigned ra(a), rb(b);
+		ra.reduce(m);
+		rb.reduce(m);
+		submod(ra, rb, m);
+		return;
+	}
+	if (!(a < b))
+		subtract(a, b);
+	else {
+		// a - b + m, as m - (b - a) to stay nonnegative
+		subtract(b, a);
+		subtract(m, *this);
+	}
 }
 
 /* BITWISE OPERATORS
@@ -2,6 +2,24 @@
 #define BIGUNSIGNED_H
 
 #include "NumberlikeArray.hh"
+#include <climits>
+
+/* Double-width blocks.  If the compiler has an unsigned type exactly twice as
+ * wide as unsigned long (unsigned long long where long is 32 bits, as with
+ * MSVC; unsigned __int128 where long is 64 bits, as with g++/clang on x86-64
+ * Linux), multiplication and division work a whole block at a time with
+ * Knuth's algorithms instead of bit by bit.  The choice is made here at build
+ * time and doesn't change the public interface.  Define BIGUNSIGNED_BITWISE to
+ * force the original bit-shifting algorithms. */
+#ifndef BIGUNSIGNED_BITWISE
+#if ULONG_MAX == 0xffffffffUL
+#define BIGUNSIGNED_DBLK
+typedef unsigned long long BigUnsignedDBlk;
+#elif ULONG_MAX == 0xffffffffffffffffUL && defined(__SIZEOF_INT128__)
+#define BIGUNSIGNED_DBLK
+__extension__ typedef unsigned __int128 BigUnsignedDBlk;
+#endif
+#endif
 
 /* A BigUnsigned object represents a nonnegative integer of size limited only by
  * available memory.  BigUnsigneds support most mathematical operators and can
@@ -18,6 +36,10 @@ public:
 
 	// BigUnsigneds are built with a Blk type of unsigned long.
 	typedef unsigned long Blk;
+#ifdef BIGUNSIGNED_DBLK
+	// Holds the product of two Blks (see the top of this file).
+	typedef BigUnsignedDBlk DBlk;
+#endif
 
 	typedef NumberlikeArray<Blk>::Index Index;
 	NumberlikeArray<Blk>::N;
@@ -44,6 +66,20 @@ public:
 		NumberlikeArray<Blk>::operator =(x);
 	}
 
+	/* Move constructor and move assignment.  These let temporaries, return
+	 * values and std::vector reallocations hand over their block arrays
+	 * instead of copying them. */
+	BigUnsigned(BigUnsigned &&x) noexcept
+			: NumberlikeArray<Blk>(std::move(x)) {}
+	void operator=(BigUnsigned &&x) noexcept {
+		NumberlikeArray<Blk>::operator =(std::move(x));
+	}
+
+	// Exchanges the values of two BigUnsigneds without copying blocks.
+	void swap(BigUnsigned &x) noexcept {
+		NumberlikeArray<Blk>::swap(x);
+	}
+
 	// Constructor that copies from a given array of blocks.
 	BigUnsigned(const Blk *b, Index blen) : NumberlikeArray<Blk>(b, blen) {
 		// Eliminate any leading zeros we may have been passed.
@@ -87,6 +123,10 @@ public:
 	NumberlikeArray<Blk>::getCapacity;
 	NumberlikeArray<Blk>::getLength;
 
+	/* Number of block arrays allocated by this thread so far.  Take the
+	 * difference of two readings to count the allocations of some code. */
+	NumberlikeArray<Blk>::getAllocationCount;
+
 	/* Returns the requested block, or 0 if it is beyond the length (as if
 	 * the number had 0s infinitely to the left). */
 	Blk getBlock(Index i) const { return i >= len ? 0 : blk[i]; }
@@ -194,15 +234,62 @@ public:
 	 * sense to write quotient and remainder into the same variable. */
 	void divideWithRemainder(const BigUnsigned &b, BigUnsigned &q);
 
+	/* Modular operations, also copy-less:
+	 *     c.mulmod(a, b, m)       is like  c = (a * b) % m
+	 *     c.muladdmod(a, b, d, m) is like  c = (a * b + d) % m
+	 *     c.addmod(a, b, m)       is like  c = (a + b) % m
+	 *     c.submod(a, b, m)       is like  c = (a - b) mod m, never negative
+	 * They reuse the block array of c, need no quotient, and with a
+	 * one-block m never leave double-width arithmetic.  Any argument may
+	 * alias c.  As with %, m == 0 means no reduction (so submod then needs
+	 * a >= b). */
+	void mulmod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m);
+	void muladdmod(const BigUnsigned &a, const BigUnsigned &b,
+		const BigUnsigned &d, const BigUnsigned &m);
+	void addmod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m);
+	void submod(const BigUnsigned &a, const BigUnsigned &b, const BigUnsigned &m);
+protected:
+	// *this %= m without computing the quotient; *this must not alias m.
+	void reduce(const BigUnsigned &m);
+#ifdef BIGUNSIGNED_DBLK
+	// Block-at-a-time core of divideWithRemainder; see BigUnsigned.cc.
+	void divideWithRemainderKnuth(const BigUnsigned &b, BigUnsigned *q);
+	// x % m for a one-block modulus m
+	static Blk reduceBlock(const BigUnsigned &x, Blk m);
+	// Sets *this to a value of at most one block.
+	void setSingleBlock(Blk x) {
+		if (x == 0)
+			len = 0;
+		else {
+			allocate(1);
+			blk[0] = x;
+			len = 1;
+		}
+	}
+#endif
+public:
+
 	/* `divide' and `modulo' are no longer offered.  Use
 	 * `divideWithRemainder' instead. */
 
 	// OVERLOADED RETURN-BY-VALUE OPERATORS
-	BigUnsigned operator +(const BigUnsigned &x) const;
-	BigUnsigned operator -(const BigUnsigned &x) const;
+	BigUnsigned operator +(const BigUnsigned &x) const &;
+	BigUnsigned operator -(const BigUnsigned &x) const &;
 	BigUnsigned operator *(const BigUnsigned &x) const;
-	BigUnsigned operator /(const BigUnsigned &x) const;
-	BigUnsigned operator %(const BigUnsigned &x) const;
+	BigUnsigned operator /(const BigUnsigned &x) const &;
+	BigUnsigned operator %(const BigUnsigned &x) const &;
+	/* Overloads for temporary operands.  These compute the result in the
+	 * block array of an operand that is about to die instead of allocating
+	 * a new one, so that e.g. `(a * b) % m' costs one product array and no
+	 * copy of it.  (Multiplication can't be done in place, so `*' has none.) */
+	BigUnsigned operator +(const BigUnsigned &x) &&;
+	BigUnsigned operator +(BigUnsigned &&x) const &;
+	BigUnsigned operator +(BigUnsigned &&x) &&;
+	BigUnsigned operator -(const BigUnsigned &x) &&;
+	BigUnsigned operator -(BigUnsigned &&x) const &;
+	BigUnsigned operator -(BigUnsigned &&x) &&;
+	BigUnsigned operator /(const BigUnsigned &x) &&;
+	BigUnsigned operator %(const BigUnsigned &x) &&;
 	/* OK, maybe unary minus could succeed in one case, but it really
 	 * shouldn't be used, so it isn't provided. */
 	BigUnsigned operator &(const BigUnsigned &x) const;
@@ -244,12 +331,12 @@ public:
  * copy-less operations.  The copy-less operations are responsible for making
  * any necessary temporary copies to work around aliasing. */
 
-inline BigUnsigned BigUnsigned::operator +(const BigUnsigned &x) const {
+inline BigUnsigned BigUnsigned::operator +(const BigUnsigned &x) const & {
 	BigUnsigned ans;
 	ans.add(*this, x);
 	return ans;
 }
-inline BigUnsigned BigUnsigned::operator -(const BigUnsigned &x) const {
+inline BigUnsigned BigUnsigned::operator -(const BigUnsigned &x) const & {
 	BigUnsigned ans;
 	ans.subtract(*this, x);
 	return ans;
@@ -259,20 +346,60 @@ inline BigUnsigned BigUnsigned::operator *(const BigUnsigned &x) const {
 	ans.multiply(*this, x);
 	return ans;
 }
-inline BigUnsigned BigUnsigned::operator /(const BigUnsigned &x) const {
+inline BigUnsigned BigUnsigned::operator /(const BigUnsigned &x) const & {
 	if (x.isZero()) throw "BigUnsigned::operator /: division by zero";
 	BigUnsigned q, r;
 	r = *this;
 	r.divideWithRemainder(x, q);
 	return q;
 }
-inline BigUnsigned BigUnsigned::operator %(const BigUnsigned &x) const {
+inline BigUnsigned BigUnsigned::operator %(const BigUnsigned &x) const & {
 	if (x.isZero()) throw "BigUnsigned::operator %: division by zero";
 	BigUnsigned q, r;
 	r = *this;
 	r.divideWithRemainder(x, q);
 	return r;
 }
+
+/* The temporary-operand versions.  `add' and `subtract' work in place when
+ * the receiver is one of their operands, so the dying operand simply becomes
+ * the answer. */
+inline BigUnsigned BigUnsigned::operator +(const BigUnsigned &x) && {
+	add(*this, x);
+	return std::move(*this);
+}
+inline BigUnsigned BigUnsigned::operator +(BigUnsigned &&x) const & {
+	x.add(*this, x);
+	return std::move(x);
+}
+inline BigUnsigned BigUnsigned::operator +(BigUnsigned &&x) && {
+	add(*this, x);
+	return std::move(*this);
+}
+inline BigUnsigned BigUnsigned::operator -(const BigUnsigned &x) && {
+	subtract(*this, x);
+	return std::move(*this);
+}
+inline BigUnsigned BigUnsigned::operator -(BigUnsigned &&x) const & {
+	x.subtract(*this, x);
+	return std::move(x);
+}
+inline BigUnsigned BigUnsigned::operator -(BigUnsigned &&x) && {
+	subtract(*this, x);
+	return std::move(*this);
+}
+inline BigUnsigned BigUnsigned::operator /(const BigUnsigned &x) && {
+	if (x.isZero()) throw "BigUnsigned::operator /: division by zero";
+	BigUnsigned q;
+	divideWithRemainder(x, q);
+	return q;
+}
+inline BigUnsigned BigUnsigned::operator %(const BigUnsigned &x) && {
+	if (x.isZero()) throw "BigUnsigned::operator %: division by zero";
+	BigUnsigned q;
+	divideWithRemainder(x, q);
+	return std::move(*this);
+}
 inline BigUnsigned BigUnsigned::operator &(const BigUnsigned &x) const {
 	BigUnsigned ans;
 	ans.bitAnd(*this, x);
@@ -339,6 +466,11 @@ inline void BigUnsigned::operator >>=(int b) {
 	bitShiftRight(*this, b);
 }
 
+// Lets std::sort and friends find the block-swapping swap.
+inline void swap(BigUnsigned &a, BigUnsigned &b) noexcept {
+	a.swap(b);
+}
+
 /* Templates for conversions of BigUnsigned to and from primitive integers.
  * BigInteger.cc needs to instantiate convertToPrimitive, and the uses in
  * BigUnsigned.cc didn't do the trick; I think g++ inlined convertToPrimitive
@@ -359,7 +491,7 @@ void BigUnsigned::initFromPrimitive(X x) {
 	else {
 		// Create a single block.  blk is NULL; no need to delete it.
 		cap = 1;
-		blk = new Blk[1];
+		blk = newBlocks(1);
 		len = 1;
 		blk[0] = Blk(x);
 	}
@@ -6,6 +6,9 @@
 #define NULL 0
 #endif
 
+#include <utility>
+#include "ScratchArena.hh"
+
 /* A NumberlikeArray<Blk> object holds a heap-allocated array of Blk with a
  * length and a capacity and provides basic memory management features.
  * BigUnsigned and BigUnsignedInABase both subclass it.
@@ -33,9 +36,22 @@ public:
 	// Heap-allocated array of the blocks (can be NULL if len == 0)
 	Blk *blk;
 
+	/* All block arrays are obtained from and returned through these two
+	 * functions.  They come from the current thread's ScratchArena while a
+	 * ScratchArena::Scope is alive and from the heap otherwise; see
+	 * ScratchArena.hh.  getAllocationCount counts the heap allocations made
+	 * by this thread. */
+	static Blk *newBlocks(Index c);
+	static void deleteBlocks(Blk *b);
+	static unsigned long getAllocationCount() { return allocationCount; }
+
+private:
+	static thread_local unsigned long allocationCount;
+
+public:
 	// Constructs a ``zero'' NumberlikeArray with the given capacity.
 	NumberlikeArray(Index c) : cap(c), len(0) { 
-		blk = (cap > 0) ? (new Blk[cap]) : NULL;
+		blk = (cap > 0) ? newBlocks(cap) : NULL;
 	}
 
 	/* Constructs a zero NumberlikeArray without allocating a backing array.
@@ -46,9 +62,9 @@ public:
 		blk = NULL;
 	}
 
-	// Destructor.  Note that `delete NULL' is a no-op.
+	// Destructor.  Note that `deleteBlocks(NULL)' is a no-op.
 	~NumberlikeArray() {
-		delete [] blk;
+		deleteBlocks(blk);
 	}
 
 	/* Ensures that the array has at least the requested capacity; may
@@ -65,6 +81,28 @@ public:
 	// Assignment operator
 	void operator=(const NumberlikeArray<Blk> &x);
 
+	/* Move constructor: takes over x's array and leaves x a zero
+	 * NumberlikeArray without a backing array. */
+	NumberlikeArray(NumberlikeArray<Blk> &&x) noexcept
+			: cap(x.cap), len(x.len), blk(x.blk) {
+		x.cap = 0;
+		x.len = 0;
+		x.blk = NULL;
+	}
+
+	/* Move assignment: exchanges arrays with x, so our old array is freed
+	 * (or reused) by whoever owns x next. */
+	void operator=(NumberlikeArray<Blk> &&x) noexcept {
+		swap(x);
+	}
+
+	// Exchanges the arrays of two NumberlikeArrays without copying blocks.
+	void swap(NumberlikeArray<Blk> &x) noexcept {
+		std::swap(cap, x.cap);
+		std::swap(len, x.len);
+		std::swap(blk, x.blk);
+	}
+
 	// Constructor that copies from a given array of blocks
 	NumberlikeArray(const Blk *b, Index blen);
 
@@ -90,15 +128,32 @@ public:
 template <class Blk>
 const unsigned int NumberlikeArray<Blk>::N = 8 * sizeof(Blk);
 
+template <class Blk>
+thread_local unsigned long NumberlikeArray<Blk>::allocationCount = 0;
+
+template <class Blk>
+Blk *NumberlikeArray<Blk>::newBlocks(Index c) {
+	bool fromHeap;
+	Blk *b = static_cast<Blk *>(ScratchArena::allocate(c * sizeof(Blk), fromHeap));
+	if (fromHeap)
+		allocationCount++;
+	return b;
+}
+
+template <class Blk>
+void NumberlikeArray<Blk>::deleteBlocks(Blk *b) {
+	ScratchArena::release(b);
+}
+
 template <class Blk>
 void NumberlikeArray<Blk>::allocate(Index c) {
 	// If the requested capacity is more than the current capacity...
 	if (c > cap) {
 		// Delete the old number array
-		delete [] blk;
+		deleteBlocks(blk);
 		// Allocate the new array
 		cap = c;
-		blk = new Blk[cap];
+		blk = newBlocks(cap);
 	}
 }
 
@@ -109,13 +164,13 @@ void NumberlikeArray<Blk>::allocateAndCopy(Index c) {
 		Blk *oldBlk = blk;
 		// Allocate the new number array
 		cap = c;
-		blk = new Blk[cap];
+		blk = newBlocks(cap);
 		// Copy number blocks
 		Index i;
 		for (i = 0; i < len; i++)
 			blk[i] = oldBlk[i];
 		// Delete the old array
-		delete [] oldBlk;
+		deleteBlocks(oldBlk);
 	}
 }
 
@@ -124,7 +179,7 @@ NumberlikeArray<Blk>::NumberlikeArray(const NumberlikeArray<Blk> &x)
 		: len(x.len) {
 	// Create array
 	cap = len;
-	blk = new Blk[cap];
+	blk = newBlocks(cap);
 	// Copy blocks
 	Index i;
 	for (i = 0; i < len; i++)
@@ -151,7 +206,7 @@ template <class Blk>
 NumberlikeArray<Blk>::NumberlikeArray(const Blk *b, Index blen)
 		: cap(blen), len(blen) {
 	// Create array
-	blk = new Blk[cap];
+	blk = newBlocks(cap);
 	// Copy blocks
 	Index i;
 	for (i = 0; i < len; i++)
@@ -0,0 +1,147 @@
+#include "ScratchArena.hh"
+#include <atomic>
+
+namespace {
+
+/* A chunk of memory that arrays are cut from.  refs counts the live arrays
+ * in it, plus one while it is some thread's current chunk; whoever drops the
+ * last reference frees it.  Only the owning thread allocates from it or
+ * rewinds it, but arrays may be released from any thread. */
+struct Chunk {
+	std::atomic<unsigned long> refs;
+	std::size_t size, used;
+	char *data;
+};
+
+/* The header in front of every array: the chunk it came from, or NULL for
+ * the heap.  Its alignment keeps the array aligned for any block type. */
+struct alignas(16) Header {
+	Chunk *chunk;
+};
+
+// Allocation sizes are rounded up to this so every header stays aligned.
+const std::size_t unit = sizeof(Header);
+const std::size_t initialChunkSize = 64 * 1024;
+
+Chunk *newChunk(std::size_t size) {
+	Chunk *c = new Chunk;
+	c->data = static_cast<char *>(::operator new(size));
+	c->size = size;
+	c->used = 0;
+	c->refs.store(1, std::memory_order_relaxed);
+	return c;
+}
+
+void unref(Chunk *c) {
+	if (c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		::operator delete(c->data);
+		delete c;
+	}
+}
+
+struct ThreadArena {
+	Chunk *chunk;          // NULL until first used in a Scope
+	unsigned int depth;    // number of live Scopes
+	std::size_t missed;    // bytes that didn't fit in the chunk since the last rewind
+	std::size_t wanted;    // size of the next chunk
+
+	ThreadArena() : chunk(NULL), depth(0), missed(0),
+		wanted(initialChunkSize) {}
+	~ThreadArena() {
+		if (chunk != NULL)
+			unref(chunk);
+	}
+
+	/* Called at the end of every Scope.  With nothing alive in the chunk, it
+	 * is rewound, or dropped for one big enough for everything it missed if
+	 * it ran out.  If it ran out but escaped values are keeping it alive, it
+	 * is dropped anyway once the last Scope ends, so that they can't pin the
+	 * thread to the heap. */
+	void rewind() {
+		if (chunk == NULL)
+			return;
+		if (chunk->refs.load(std::memory_order_acquire) == 1) {
+			if (missed > 0) {
+				wanted = (chunk->used + missed > 2 * wanted)
+					? chunk->used + missed : 2 * wanted;
+				unref(chunk);
+				chunk = NULL;
+			} else
+				chunk->used = 0;
+			missed = 0;
+		} else if (missed > 0 && depth == 0) {
+			unref(chunk);
+			chunk = NULL;
+			missed = 0;
+		}
+	}
+};
+
+thread_local ThreadArena arena;
+
+}
+
+void *ScratchArena::allocate(std::size_t bytes, bool &fromHeap) {
+	std::size_t total = unit + (bytes + unit - 1) / unit * unit;
+	ThreadArena &a = arena;
+	if (a.depth > 0) {
+		if (a.chunk == NULL)
+			a.chunk = newChunk(a.wanted);
+		Chunk *c = a.chunk;
+		if (c->size - c->used >= total) {
+			Header *h = reinterpret_cast<Header *>(c->data + c->used);
+			c->used += total;
+			c->refs.fetch_add(1, std::memory_order_relaxed);
+			h->chunk = c;
+			fromHeap = false;
+			return h + 1;
+		}
+		a.missed += total;
+	}
+	Header *h = static_cast<Header *>(::operator new(total));
+	h->chunk = NULL;
+	fromHeap = true;
+	return h + 1;
+}
+
+void ScratchArena::release(void *p) {
+	if (p == NULL)
+		return;
+	Header *h = static_cast<Header *>(p) - 1;
+	if (h->chunk != NULL)
+		unref(h->chunk);
+	else
+		::operator delete(h);
+}
+
+void ScratchArena::reserve(std::size_t bytes) {
+	ThreadArena &a = arena;
+	if (bytes <= a.wanted)
+		return;
+	a.wanted = bytes;
+	if (a.chunk != NULL && a.chunk->refs.load(std::memory_order_acquire) == 1) {
+		unref(a.chunk);
+		a.chunk = NULL;
+	}
+}
+
+std::size_t ScratchArena::getCapacity() {
+	return (arena.chunk != NULL) ? arena.chunk->size : arena.wanted;
+}
+
+ScratchArena::Scope::Scope() {
+	arena.depth++;
+}
+
+ScratchArena::Scope::~Scope() {
+	arena.depth--;
+	arena.rewind();
+}
+
+ScratchArena::Suspend::Suspend() : depth(arena.depth) {
+	arena.depth = 0;
+}
+
+ScratchArena::Suspend::~Suspend() {
+	arena.depth = depth;
+}
@@ -0,0 +1,98 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+#include <new>
+
+/* ScratchArena is a per-thread bump allocator for short-lived block arrays.
+ *
+ * Every block array of a NumberlikeArray is obtained through
+ * ScratchArena::allocate.  Normally that is just the heap, but while a
+ * ScratchArena::Scope object is alive on the current thread, arrays are cut
+ * from a chunk owned by that thread instead, and freeing them only
+ * decrements a count.  A hot loop body can therefore create as many
+ * temporaries as it likes:
+ *
+ *     for (...) {
+ *         ScratchArena::Scope scratch;
+ *         ... BigUnsigned and vector temporaries ...
+ *     }
+ *
+ * When a Scope ends and nothing allocated from the chunk is still alive, the
+ * chunk is rewound to the start, so the next iteration reuses the same
+ * memory and touches the heap not at all.  A value that outlives its Scope
+ * (e.g. one moved into a longer-lived object) is still valid: it merely
+ * keeps its chunk from being rewound until it is freed, which may happen on
+ * any thread.  If a chunk runs out, further allocations fall back to the
+ * heap and the chunk is replaced by a big enough one at the next rewind.
+ *
+ * Each array is preceded by a small header recording where it came from, so
+ * release() works on arrays from either source. */
+class ScratchArena {
+public:
+	// Allocates at least `bytes' bytes.  Sets fromHeap to whether the heap
+	// was used.  Throws std::bad_alloc like operator new.
+	static void *allocate(std::size_t bytes, bool &fromHeap);
+	static void *allocate(std::size_t bytes) {
+		bool fromHeap;
+		return allocate(bytes, fromHeap);
+	}
+	// Frees memory from allocate.  `release(NULL)' is a no-op.
+	static void release(void *p);
+
+	// Ensures the current thread's chunk holds at least `bytes' bytes.  Has
+	// effect only while the chunk is not in use.
+	static void reserve(std::size_t bytes);
+	// Size in bytes of the chunk the current thread is using or will use next
+	static std::size_t getCapacity();
+
+	/* While a Scope is alive on a thread, that thread allocates from its
+	 * arena.  Scopes nest; every Scope end is a chance to rewind. */
+	class Scope {
+	public:
+		Scope();
+		~Scope();
+	private:
+		Scope(const Scope &);
+		void operator=(const Scope &);
+	};
+
+	/* Inside a Scope, a Suspend sends allocations back to the heap until it
+	 * ends.  Use it when storing results into longer-lived objects, so that
+	 * they don't keep the chunk from being rewound. */
+	class Suspend {
+	public:
+		Suspend();
+		~Suspend();
+	private:
+		unsigned int depth;
+		Suspend(const Suspend &);
+		void operator=(const Suspend &);
+	};
+};
+
+/* A standard allocator on top of ScratchArena, for local containers of a hot
+ * loop, e.g. std::vector<BigUnsigned, ScratchAllocator<BigUnsigned> >. */
+template <class T>
+class ScratchAllocator {
+public:
+	typedef T value_type;
+
+	ScratchAllocator() {}
+	template <class U>
+	ScratchAllocator(const ScratchAllocator<U> &) {}
+
+	T *allocate(std::size_t n) {
+		return static_cast<T *>(ScratchArena::allocate(n * sizeof(T)));
+	}
+	void deallocate(T *p, std::size_t) {
+		ScratchArena::release(p);
+	}
+
+	template <class U>
+	bool operator ==(const ScratchAllocator<U> &) const { return true; }
+	template <class U>
+	bool operator !=(const ScratchAllocator<U> &) const { return false; }
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "Convolution.h"
+#include <iostream>
+#include <vector>
+#include <utility>
+#include "PolyMultiply.h"
+#include "general_functions.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////
+// Forward NTTs, pointwise product, inverse NTT; the negacyclic
+// ring scales by phi^i before and phi^-i after. The evaluations
+// stay in bit reversed order, so nothing is permuted.
+//////////////////////////////////////////////////////////////
+static bool convolve(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt, bool negacyclic, vector<BigUnsigned>& C) {
+	int n = ntt.vec_length.toInt();
+	if (A.size() != (size_t)n || B.size() != (size_t)n)
+		return false;
+
+	const BigUnsigned& q = ntt.modulus;
+	bool square = (&A == &B);
+
+	vector<BigUnsigned> a = ntt.calculate(negacyclic ? mult_by_power(A, ntt.phi, q) : A, false, true);
+	if (square) {
+		for (int i = 0; i < n; i++)
+			a[i] = (a[i] * a[i]) % q;
+	}
+	else {
+		vector<BigUnsigned> b = ntt.calculate(negacyclic ? mult_by_power(B, ntt.phi, q) : B, false, true);
+		for (int i = 0; i < n; i++)
+			a[i] = (a[i] * b[i]) % q;
+	}
+
+	a = ntt.calculate(move(a), true, true);
+	C = negacyclic ? mult_by_power(move(a), ntt.phi_inv, q) : move(a);
+	return true;
+}
+
+vector<BigUnsigned> multiply_cyclic(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt) {
+	vector<BigUnsigned> C;
+	convolve(A, B, ntt, false, C);
+	return C;
+}
+
+bool multiply_cyclic(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt, vector<BigUnsigned>& C) {
+	return convolve(A, B, ntt, false, C);
+}
+
+bool multiply_cyclic_inplace(vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt) {
+	return convolve(A, B, ntt, false, A);
+}
+
+vector<BigUnsigned> multiply_negacyclic(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt) {
+	vector<BigUnsigned> C;
+	convolve(A, B, ntt, true, C);
+	return C;
+}
+
+bool multiply_negacyclic(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt, vector<BigUnsigned>& C) {
+	return convolve(A, B, ntt, true, C);
+}
+
+bool multiply_negacyclic_inplace(vector<BigUnsigned>& A, const vector<BigUnsigned>& B, NTT& ntt) {
+	return convolve(A, B, ntt, true, A);
+}
+
+//////////////////////////////////////////////////////////////
+// Test
+//////////////////////////////////////////////////////////////
+bool convolution_test(NTT& ntt, int n_tests) {
+	int n_correct = 0;
+	BigUnsigned q = ntt.modulus;
+	int n = ntt.vec_length.toInt();
+
+	for (int t = 0; t < n_tests; t++) {
+		bool negacyclic = (t % 2 == 0);
+		vector<BigUnsigned> A = sample_polynomial(n, q);
+		vector<BigUnsigned> B = sample_polynomial(n, q);
+		vector<BigUnsigned> expected = PolyMultiplier::multiply(A, B, q, negacyclic, POLYMULT_SCHOOLBOOK);
+		vector<BigUnsigned> square   = PolyMultiplier::multiply(A, A, q, negacyclic, POLYMULT_SCHOOLBOOK);
+
+		// returned, into a buffer, into B itself, in place, squared
+		vector<BigUnsigned> C, B_in = B, A_in = A, A_sq = A;
+		bool correct;
+		if (negacyclic) {
+			correct = vectorsAreEqual(multiply_negacyclic(A, B, ntt), expected) && multiply_negacyclic(A, B, ntt, C) && vectorsAreEqual(C, expected)
+				&& multiply_negacyclic(A, B_in, ntt, B_in) && vectorsAreEqual(B_in, expected)
+				&& multiply_negacyclic_inplace(A_in, B, ntt) && vectorsAreEqual(A_in, expected)
+				&& multiply_negacyclic_inplace(A_sq, A_sq, ntt) && vectorsAreEqual(A_sq, square);
+		}
+		else {
+			correct = vectorsAreEqual(multiply_cyclic(A, B, ntt), expected) && multiply_cyclic(A, B, ntt, C) && vectorsAreEqual(C, expected)
+				&& multiply_cyclic(A, B_in, ntt, B_in) && vectorsAreEqual(B_in, expected)
+				&& multiply_cyclic_inplace(A_in, B, ntt) && vectorsAreEqual(A_in, expected)
+				&& multiply_cyclic_inplace(A_sq, A_sq, ntt) && vectorsAreEqual(A_sq, square);
+		}
+
+		// wrong length: false, buffer untouched
+		vector<BigUnsigned> short_A(n - 1), D = expected;
+		correct = correct && !multiply_cyclic(short_A, B, ntt, D) && vectorsAreEqual(D, expected) && multiply_negacyclic(short_A, B, ntt).empty();
+
+		if (correct)
+			n_correct++;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
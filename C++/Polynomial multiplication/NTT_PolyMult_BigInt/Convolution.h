@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "NTT.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Cyclic and negacyclic convolution with an NTT
+//
+//   multiply_cyclic       A * B mod (x^n - 1, q)
+//   multiply_negacyclic   A * B mod (x^n + 1, q), the negative
+//                         wrapped convolution (inputs scaled by
+//                         powers of phi, output by powers of
+//                         phi^-1)
+//
+// with n = ntt.vec_length, q = ntt.modulus and coefficients
+// below q. These compute what polynomial_multiply() and
+// negative_wrapped_convolution() in main.cpp print, for use in
+// a loop: no console output, no reference (stupidcalculate)
+// transforms, and the NTT is taken by reference, not copied.
+// A squaring (&A == &B) transforms its operand once.
+//
+// The output-buffer forms write C, which may be A or B, and
+// return false (C untouched) when a length is not n; the
+// in-place forms overwrite A with A * B. The returning forms
+// give an empty vector on a length mismatch.
+//////////////////////////////////////////////////////////////
+std::vector<BigUnsigned> multiply_cyclic(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt);
+bool multiply_cyclic(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt, std::vector<BigUnsigned>& C);
+bool multiply_cyclic_inplace(std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt);
+
+std::vector<BigUnsigned> multiply_negacyclic(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt);
+bool multiply_negacyclic(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt, std::vector<BigUnsigned>& C);
+bool multiply_negacyclic_inplace(std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, NTT& ntt);
+
+// Every form against schoolbook, in both rings
+bool convolution_test(NTT& ntt, int n_tests);
@@ -0,0 +1,312 @@
+#include "MontgomeryCIOS.h"
+#include <iostream>
+#include <chrono>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+typedef MontgomeryCIOS::word word;
+
+//////////////////////////////////////////////////////////////
+// Word multiply-accumulate
+// returns the low word of a*b + c + d and sets hi to the high
+// word. The sum always fits in two words.
+//////////////////////////////////////////////////////////////
+static inline word mulAdd(word a, word b, word c, word d, word& hi) {
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 t = (unsigned __int128)a * b + c + d;
+	hi = word(t >> 64);
+	return word(t);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	word h;
+	word lo = _umul128(a, b, &h);
+	lo += c;
+	h  += (lo < c);
+	lo += d;
+	h  += (lo < d);
+	hi = h;
+	return lo;
+#else
+	// 32 x 32 bit partial products
+	word aL = a & 0xffffffff, aH = a >> 32;
+	word bL = b & 0xffffffff, bH = b >> 32;
+	word ll = aL * bL, lh = aL * bH, hl = aH * bL, hh = aH * bH;
+	word mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+	word lo = (ll & 0xffffffff) | (mid << 32);
+	word h = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	lo += c;
+	h  += (lo < c);
+	lo += d;
+	h  += (lo < d);
+	hi = h;
+	return lo;
+#endif
+}
+
+// returns true if a >= b, both n words
+static inline bool geq(const word* a, const word* b, int n) {
+	for (int i = n - 1; i >= 0; i--) {
+		if (a[i] != b[i])
+			return a[i] > b[i];
+	}
+	return true;
+}
+
+// a -= b over n words, returns the borrow
+static inline word subWords(word* a, const word* b, int n) {
+	word borrow = 0;
+	for (int i = 0; i < n; i++) {
+		word t = a[i] - b[i];
+		word borrowOut = (t > a[i]);
+		if (borrow) {
+			borrowOut |= (t == 0);
+			t--;
+		}
+		a[i] = t;
+		borrow = borrowOut;
+	}
+	return borrow;
+}
+
+//////////////////////////////////////////////////////////////
+// Montgomery product, Coarsely Integrated Operand Scanning
+// out = a * b * R^-1 mod modulus  (Koc, Acar, Kaliski 1996)
+//
+// Each outer step adds a*b[i] to t and then adds m*N, with m
+// chosen so the low word becomes zero, and shifts t down a
+// word. t < 2*modulus at the end so one subtraction finishes.
+//////////////////////////////////////////////////////////////
+void MontgomeryCIOS::mult(word* out, const word* a, const word* b) const {
+	int s = n_words;
+	word t[MAX_WORDS + 2] = { 0 };
+
+	for (int i = 0; i < s; i++) {
+		// t += a * b[i]
+		word C = 0;
+		for (int j = 0; j < s; j++)
+			t[j] = mulAdd(a[j], b[i], t[j], C, C);
+		word sum = t[s] + C;
+		t[s + 1] = (sum < C);
+		t[s] = sum;
+
+		// t = (t + m * N) / 2^64
+		word m = t[0] * n_prime;
+		mulAdd(m, N[0], t[0], 0, C);
+		for (int j = 1; j < s; j++)
+			t[j - 1] = mulAdd(m, N[j], t[j], C, C);
+		sum = t[s] + C;
+		t[s - 1] = sum;
+		t[s] = t[s + 1] + (sum < C);
+	}
+
+	if (t[s] != 0 || geq(t, N, s))
+		subWords(t, N, s);
+
+	for (int j = 0; j < s; j++)
+		out[j] = t[j];
+}
+
+//////////////////////////////////////////////////////////////
+// Modular add / subtract of reduced word arrays
+//////////////////////////////////////////////////////////////
+void MontgomeryCIOS::add(word* out, const word* a, const word* b) const {
+	word t[MAX_WORDS];
+	word carry = 0;
+	for (int j = 0; j < n_words; j++) {
+		word sum = a[j] + carry;
+		carry = (sum < carry);
+		t[j] = sum + b[j];
+		carry += (t[j] < sum);
+	}
+	if (carry || geq(t, N, n_words))
+		subWords(t, N, n_words);
+
+	for (int j = 0; j < n_words; j++)
+		out[j] = t[j];
+}
+
+void MontgomeryCIOS::sub(word* out, const word* a, const word* b) const {
+	word t[MAX_WORDS];
+	for (int j = 0; j < n_words; j++)
+		t[j] = a[j];
+
+	// add the modulus back if a < b
+	if (subWords(t, b, n_words)) {
+		word carry = 0;
+		for (int j = 0; j < n_words; j++) {
+			word sum = t[j] + carry;
+			carry = (sum < carry);
+			t[j] = sum + N[j];
+			carry += (t[j] < sum);
+		}
+	}
+
+	for (int j = 0; j < n_words; j++)
+		out[j] = t[j];
+}
+
+void MontgomeryCIOS::toMontgomery(word* out, const word* a) const {
+	mult(out, a, R2);
+}
+
+void MontgomeryCIOS::fromMontgomery(word* out, const word* a) const {
+	word unit[MAX_WORDS] = { 1 };
+	mult(out, a, unit);
+}
+
+//////////////////////////////////////////////////////////////
+// Conversion between BigUnsigned and word arrays
+// (BigUnsigned blocks are 32 bits with MSVC, 64 bits with gcc)
+//////////////////////////////////////////////////////////////
+void MontgomeryCIOS::toWords(BigUnsigned val, word* out) const {
+	for (int j = 0; j < n_words; j++)
+		out[j] = 0;
+
+	for (BigUnsigned::Index i = 0; i < val.getLength(); i++) {
+		unsigned int bit = i * BigUnsigned::N;
+		out[bit / 64] |= word(val.getBlock(i)) << (bit % 64);
+	}
+}
+
+BigUnsigned MontgomeryCIOS::fromWords(const word* in) const {
+	BigUnsigned val;
+	int n_blocks = n_words * 64 / BigUnsigned::N;
+
+	// top block first so the number is only allocated once
+	for (int i = n_blocks - 1; i >= 0; i--) {
+		unsigned int bit = i * BigUnsigned::N;
+		val.setBlock(i, BigUnsigned::Blk(in[bit / 64] >> (bit % 64)));
+	}
+	return val;
+}
+
+//////////////////////////////////////////////////////////////
+// BigUnsigned interface
+//
+// modmult does two Montgomery products and no conversions:
+// (a*b*R^-1) * R^2 * R^-1 = a*b mod modulus
+//////////////////////////////////////////////////////////////
+BigUnsigned MontgomeryCIOS::modmult(BigUnsigned A, BigUnsigned B) const {
+	if (A >= modulus)
+		A %= modulus;
+	if (B >= modulus)
+		B %= modulus;
+
+	word a[MAX_WORDS], b[MAX_WORDS], t[MAX_WORDS];
+	toWords(A, a);
+	toWords(B, b);
+	mult(t, a, b);
+	mult(t, t, R2);
+	return fromWords(t);
+}
+
+// left to right square and multiply
+BigUnsigned MontgomeryCIOS::pow(BigUnsigned base, BigUnsigned ex) const {
+	if (base >= modulus)
+		base %= modulus;
+
+	word x[MAX_WORDS], r[MAX_WORDS];
+	toWords(base, x);
+	toMontgomery(x, x);
+	for (int j = 0; j < n_words; j++)
+		r[j] = one[j];
+
+	for (int i = int(ex.bitLength()) - 1; i >= 0; i--) {
+		mult(r, r, r);
+		if (ex.getBit(i))
+			mult(r, r, x);
+	}
+
+	fromMontgomery(r, r);
+	return fromWords(r);
+}
+
+//////////////////////////////////////////////////////////////
+// Test against BigUnsigned, and time both
+//////////////////////////////////////////////////////////////
+void MontgomeryCIOS::modmultTest(int n_tests) {
+	int n_correct = 0;
+	vector<BigUnsigned> A, B, ans;
+
+	cout << endl << endl << "CIOS Montgomery Multiplication Test (" << n_words << " words): " << endl;
+
+	// random values over the full width of the modulus
+	for (int i = 0; i < n_tests; i++) {
+		BigUnsigned a = 0, b = 0;
+		for (int j = 0; j < modulus.bitLength(); j += 15) {
+			a = (a << 15) + (rand() & 0x7fff);
+			b = (b << 15) + (rand() & 0x7fff);
+		}
+		A.push_back(a % modulus);
+		B.push_back(b % modulus);
+	}
+
+	auto t0 = chrono::steady_clock::now();
+	for (int i = 0; i < n_tests; i++)
+		ans.push_back((A[i] * B[i]) % modulus);
+	auto t1 = chrono::steady_clock::now();
+	for (int i = 0; i < n_tests; i++) {
+		if (modmult(A[i], B[i]) == ans[i])
+			n_correct++;
+		else
+			cout << "Incorrect." << endl;
+	}
+	auto t2 = chrono::steady_clock::now();
+
+	// the word level product alone, as used inside the NTT
+	vector<word> a(n_tests * n_words), b(n_tests * n_words);
+	for (int i = 0; i < n_tests; i++) {
+		toWords(A[i], &a[i * n_words]);
+		toWords(B[i], &b[i * n_words]);
+	}
+	auto t3 = chrono::steady_clock::now();
+	for (int i = 0; i < n_tests; i++)
+		mult(&a[i * n_words], &a[i * n_words], &b[i * n_words]);
+	auto t4 = chrono::steady_clock::now();
+
+	// exponentiation against the library
+	for (int i = 0; i < n_tests && i < 10; i++) {
+		if (pow(A[i], B[i]) != modexp(A[i], B[i], modulus)) {
+			cout << "Incorrect pow." << endl;
+			n_correct--;
+		}
+	}
+
+	cout << endl << n_correct << "/" << n_tests << " tests correct." << endl;
+	cout << "BigUnsigned (A*B) % modulus: " << chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count() / n_tests << " ns per multiplication." << endl;
+	cout << "CIOS modmult:                " << chrono::duration_cast<chrono::nanoseconds>(t2 - t1).count() / n_tests << " ns per multiplication." << endl;
+	cout << "CIOS word product:           " << chrono::duration_cast<chrono::nanoseconds>(t4 - t3).count() / n_tests << " ns per multiplication." << endl << endl;
+}
+
+//////////////////////////////////////////////////////////////
+// Initialization parameters
+//////////////////////////////////////////////////////////////
+bool MontgomeryCIOS::supports(BigUnsigned mod) {
+	return (mod > 1) && mod.getBit(0) && (mod.bitLength() <= 64 * MAX_WORDS);
+}
+
+//////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////
+MontgomeryCIOS::MontgomeryCIOS(BigUnsigned mod) {
+	if (!supports(mod)) {
+		cout << "ERROR: CIOS Montgomery needs an odd modulus of at most " << 64 * MAX_WORDS << " bits, got " << mod << "." << endl;
+		return;
+	}
+
+	modulus = mod;
+	n_words = (mod.bitLength() + 63) / 64;
+	toWords(mod, N);
+
+	// Newton iteration for N[0]^-1 mod 2^64, doubling correct bits each step
+	word inv = N[0];
+	for (int i = 0; i < 5; i++)
+		inv *= 2 - N[0] * inv;
+	n_prime = 0 - inv;
+
+	toWords((BigUnsigned(1) << (128 * n_words)) % mod, R2);
+	toWords((BigUnsigned(1) << (64 * n_words)) % mod, one);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Fixed-width Montgomery multiplication (CIOS)
+//
+// For odd moduli of 1 to MAX_WORDS 64-bit words (up to 384 bits).
+// Values are kept as little endian arrays of n_words words in
+// Montgomery form (x*R mod modulus, R = 2^(64*n_words)), so a
+// modular multiplication is a single pass of word multiplies
+// instead of a BigUnsigned product and division.
+//
+// n' and R^2 are computed once per modulus in the constructor.
+//////////////////////////////////////////////////////////////
+class MontgomeryCIOS
+{
+
+public:
+	typedef unsigned long long word;
+	static const int MAX_WORDS = 6;
+
+	BigUnsigned modulus = 0;
+	int n_words = 0;
+
+	word N[MAX_WORDS];        // modulus
+	word R2[MAX_WORDS];       // R^2 mod modulus, converts into Montgomery form
+	word one[MAX_WORDS];      // R mod modulus, 1 in Montgomery form
+	word n_prime = 0;         // -modulus^-1 mod 2^64
+
+	static bool supports(BigUnsigned mod);
+
+	// Word array functions. All inputs must be reduced (< modulus).
+	void mult(word* out, const word* a, const word* b) const;   // a*b*R^-1
+	void add(word* out, const word* a, const word* b) const;
+	void sub(word* out, const word* a, const word* b) const;
+	void toMontgomery(word* out, const word* a) const;
+	void fromMontgomery(word* out, const word* a) const;
+
+	void toWords(BigUnsigned val, word* out) const;
+	BigUnsigned fromWords(const word* in) const;
+
+	// BigUnsigned interface
+	BigUnsigned modmult(BigUnsigned A, BigUnsigned B) const;
+	BigUnsigned pow(BigUnsigned base, BigUnsigned ex) const;
+
+	void modmultTest(int n_tests);
+
+	MontgomeryCIOS() {}
+	MontgomeryCIOS(BigUnsigned mod);
+};
@@ -0,0 +1,312 @@
+#include "MultiPrimeNTT.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "NTT.h"
+#include "RNS.h"
+#include "Polynomial.h"
+#include "PolyMatrix.h"
+#include "PolyMultiply.h"
+#include "primality.h"
+#include "general_functions.h"
+
+using namespace std;
+
+typedef MultiPrimeNTT::word word;
+
+map<pair<int, int>, MultiPrimeNTT> MultiPrimeNTT::plans;
+mutex MultiPrimeNTT::lock;
+
+// x mod q, Horner over the blocks of x; block_shift = 2^BigUnsigned::N in Montgomery form
+static word residue(const BigUnsigned& x, word q, word q_inv, word block_shift) {
+	word r = 0;
+	for (int b = (int)x.getLength() - 1; b >= 0; b--) {
+		r = static_ntt::mont_mul_rt(r, block_shift, q, q_inv);
+		r += (word)x.getBlock(b) % q;
+		if (r >= q)
+			r -= q;
+	}
+	return r;
+}
+
+// n random coefficients below 2^bits (sample_polynomial stops at 31 bits)
+static vector<BigUnsigned> sample_wide(int n, int bits) {
+	vector<BigUnsigned> A(n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < bits; j += 15)
+			A[i] = (A[i] << 15) + (rand() & 0x7fff);
+		A[i] = A[i] % (BigUnsigned(1) << bits);
+	}
+	return A;
+}
+
+static int ceil_log2(unsigned long long x) {
+	int bits = 0;
+	while ((1ULL << bits) < x)
+		bits++;
+	return bits;
+}
+
+//////////////////////////////////////////////////////////////
+// Plan: transform length, primes, twiddles, Garner constants
+//////////////////////////////////////////////////////////////
+MultiPrimeNTT::MultiPrimeNTT(int max_length, int bound_bits) : max_length(max_length), bound_bits(bound_bits) {
+	vec_length = 2;
+	while (vec_length < max_length)
+		vec_length *= 2;
+
+	// every prime is above 2^(PRIME_BITS - 1)
+	int n_primes = (bound_bits + PRIME_BITS - 2) / (PRIME_BITS - 1);
+	if (n_primes < 1)
+		n_primes = 1;
+
+	primes = RNS::determineNTTprimes(PRIME_BITS, n_primes, vec_length, true);
+	if (primes.size() < n_primes) {
+		cout << "ERROR: no " << n_primes << " primes for a multi-prime NTT of length " << vec_length << "." << endl;
+		primes.clear();
+		return;
+	}
+
+	dynamic_range = 1;
+	for (int c = 0; c < n_primes; c++) {
+		Channel ch;
+		ch.q     = to_u64(primes[c]);
+		ch.q_inv = static_ntt::neg_inverse(ch.q);
+
+		word w     = static_ntt::root_of_unity(vec_length, ch.q);
+		word w_inv = static_ntt::inverse_mod(w, ch.q);
+		word w_m   = static_ntt::to_montgomery(w, ch.q);
+		word w_inv_m = static_ntt::to_montgomery(w_inv, ch.q);
+		ch.forward_twiddles.resize(vec_length / 2);
+		ch.inverse_twiddles.resize(vec_length / 2);
+		ch.forward_twiddles[0] = ch.inverse_twiddles[0] = static_ntt::to_montgomery(1, ch.q);
+		for (int i = 1; i < vec_length / 2; i++) {
+			ch.forward_twiddles[i] = static_ntt::mont_mul_rt(ch.forward_twiddles[i - 1], w_m, ch.q, ch.q_inv);
+			ch.inverse_twiddles[i] = static_ntt::mont_mul_rt(ch.inverse_twiddles[i - 1], w_inv_m, ch.q, ch.q_inv);
+		}
+
+		ch.block_shift = static_ntt::to_montgomery(static_ntt::pow_mod(2, BigUnsigned::N, ch.q), ch.q);
+		word n_inv = static_ntt::inverse_mod(vec_length, ch.q);
+		ch.scale = static_ntt::to_montgomery(static_ntt::to_montgomery(n_inv, ch.q), ch.q);
+
+		for (int j = 0; j < c; j++)
+			ch.garner.push_back(static_ntt::to_montgomery(static_ntt::inverse_mod(to_u64(primes[j]) % ch.q, ch.q), ch.q));
+
+		channels.push_back(ch);
+		dynamic_range *= primes[c];
+	}
+}
+
+//////////////////////////////////////////////////////////////
+// Bits of min(|A|, |B|) * max(A) * max(B), rounded up
+//////////////////////////////////////////////////////////////
+int MultiPrimeNTT::boundBits(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B) {
+	int bits_a = 0, bits_b = 0;
+	for (int i = 0; i < A.size(); i++)
+		bits_a = max(bits_a, (int)A[i].bitLength());
+	for (int i = 0; i < B.size(); i++)
+		bits_b = max(bits_b, (int)B[i].bitLength());
+	return bits_a + bits_b + ceil_log2(min(A.size(), B.size()));
+}
+
+//////////////////////////////////////////////////////////////
+// One cyclic product of length N per prime, then Garner per
+// coefficient. Primes and coefficients are spread over
+// PolyMatrix::threadCount() threads.
+//////////////////////////////////////////////////////////////
+vector<BigUnsigned> MultiPrimeNTT::multiply(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B) const {
+	if (A.empty() || B.empty())
+		return vector<BigUnsigned>();
+
+	int length = A.size() + B.size() - 1;
+	if (channels.empty() || length > vec_length || boundBits(A, B) > bound_bits) {
+		cout << "ERROR: a product of " << A.size() << " and " << B.size() << " coefficients (bound 2^" << boundBits(A, B)
+			<< ") does not fit a multi-prime NTT of length " << vec_length << " and bound 2^" << bound_bits << "." << endl;
+		return vector<BigUnsigned>();
+	}
+
+	int k = channels.size();
+	vector<vector<word>> z(k);
+	PolyMatrix::parallelFor(k, [&](int c) {
+		const Channel& ch = channels[c];
+		vector<word> a(vec_length, 0), b(vec_length, 0);
+		for (int i = 0; i < A.size(); i++)
+			a[i] = residue(A[i], ch.q, ch.q_inv, ch.block_shift);
+		for (int i = 0; i < B.size(); i++)
+			b[i] = residue(B[i], ch.q, ch.q_inv, ch.block_shift);
+
+		static_ntt::transform(a.data(), vec_length, ch.forward_twiddles.data(), ch.q, ch.q_inv);
+		static_ntt::transform(b.data(), vec_length, ch.forward_twiddles.data(), ch.q, ch.q_inv);
+		for (int i = 0; i < vec_length; i++)
+			a[i] = static_ntt::mont_mul_rt(a[i], b[i], ch.q, ch.q_inv);            // a*b / 2^64
+		static_ntt::transform(a.data(), vec_length, ch.inverse_twiddles.data(), ch.q, ch.q_inv);
+		for (int i = 0; i < length; i++)
+			a[i] = static_ntt::mont_mul_rt(a[i], ch.scale, ch.q, ch.q_inv);        // / N, * 2^64
+		z[c].swap(a);
+	});
+
+	vector<BigUnsigned> C(length);
+	PolyMatrix::parallelFor(length, [&](int i) {
+		vector<word> x(k);
+		for (int c = 0; c < k; c++)
+			x[c] = z[c][i];
+		C[i] = garner(x.data());
+	});
+	return C;
+}
+
+vector<BigUnsigned> MultiPrimeNTT::exactProduct(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B) {
+	if (A.empty() || B.empty())
+		return vector<BigUnsigned>();
+
+	int length = A.size() + B.size() - 1;
+	int n = 2;
+	while (n < length)
+		n *= 2;
+	int n_primes = max(1, (boundBits(A, B) + PRIME_BITS - 2) / (PRIME_BITS - 1));
+
+	map<pair<int, int>, MultiPrimeNTT>::iterator it;
+	{
+		lock_guard<mutex> guard(lock);
+		it = plans.find(make_pair(n, n_primes));
+		if (it == plans.end())
+			it = plans.insert(make_pair(make_pair(n, n_primes), MultiPrimeNTT(n, n_primes * (PRIME_BITS - 1)))).first;
+	}
+	return it->second.multiply(A, B);
+}
+
+//////////////////////////////////////////////////////////////
+// Garner: x = v[0] + v[1] p_0 + v[2] p_0 p_1 + ..., each mixed
+// radix digit v[c] < p_c found with word products only
+//////////////////////////////////////////////////////////////
+BigUnsigned MultiPrimeNTT::garner(const word* x) const {
+	int k = channels.size();
+	vector<word> v(k);
+	for (int c = 0; c < k; c++) {
+		const Channel& ch = channels[c];
+		word t = x[c];
+		for (int j = 0; j < c; j++) {
+			word d = v[j] % ch.q;
+			t = (t >= d) ? t - d : t + (ch.q - d);
+			t = static_ntt::mont_mul_rt(t, ch.garner[j], ch.q, ch.q_inv);           // (t - v_j) / p_j
+		}
+		v[c] = t;
+	}
+
+	BigUnsigned result = from_u64(v[k - 1]);
+	for (int c = k - 2; c >= 0; c--)
+		result = result * primes[c] + from_u64(v[c]);
+	return result;
+}
+
+//////////////////////////////////////////////////////////////
+// Conversions, as RNS::forwardConverter_polynomial and
+// RNS::reverseConverter_polynomial with base = primes
+//////////////////////////////////////////////////////////////
+vector<vector<BigUnsigned>> MultiPrimeNTT::forwardConverter_polynomial(const vector<BigUnsigned>& A) const {
+	vector<vector<BigUnsigned>> A_rns(A.size(), vector<BigUnsigned>(channels.size()));
+	for (int i = 0; i < A.size(); i++) {
+		for (int c = 0; c < channels.size(); c++)
+			A_rns[i][c] = from_u64(residue(A[i], channels[c].q, channels[c].q_inv, channels[c].block_shift));
+	}
+	return A_rns;
+}
+
+vector<BigUnsigned> MultiPrimeNTT::reverseConverter_polynomial(const vector<vector<BigUnsigned>>& A_rns) const {
+	vector<BigUnsigned> A(A_rns.size());
+	vector<word> x(channels.size());
+	for (int i = 0; i < A_rns.size(); i++) {
+		if (A_rns[i].size() != channels.size()) {
+			cout << "ERROR: " << A_rns[i].size() << " residues for " << channels.size() << " primes." << endl;
+			return vector<BigUnsigned>();
+		}
+		for (int c = 0; c < channels.size(); c++)
+			x[c] = to_u64(A_rns[i][c] % primes[c]);
+		A[i] = garner(x.data());
+	}
+	return A;
+}
+
+//////////////////////////////////////////////////////////////
+// Against the Karatsuba integer product of PolyMultiplier, for
+// unbalanced lengths and coefficients of 1 to 300 bits
+//////////////////////////////////////////////////////////////
+bool MultiPrimeNTT::multiPrimeTest(int n_tests) {
+	int n_correct = 0;
+	const int lengths[] = { 1, 2, 5, 16, 33, 100, 256, 300 };
+	const int bits[]    = { 1, 16, 60, 64, 100, 300 };
+
+	for (int t = 0; t < n_tests; t++) {
+		int n_a = lengths[t % 8];
+		int n_b = lengths[(t / 2 + 3) % 8];
+		vector<BigUnsigned> A = sample_wide(n_a, bits[t % 6]);
+		vector<BigUnsigned> B = sample_wide(n_b, bits[t % 6]);
+		vector<BigUnsigned> expected = PolyMultiplier::linearProduct(A, B);
+
+		MultiPrimeNTT plan(n_a + n_b - 1, boundBits(A, B));
+		bool correct = vectorsAreEqual(plan.multiply(A, B), expected) && vectorsAreEqual(exactProduct(A, B), expected);
+		if (correct) {
+			vector<BigUnsigned> X = sample_wide(n_a, plan.dynamic_range.bitLength() - 1);
+			correct = vectorsAreEqual(plan.reverseConverter_polynomial(plan.forwardConverter_polynomial(X)), X);
+		}
+		if (!correct)
+			cout << "Multi-prime product wrong for lengths " << n_a << " and " << n_b << ", " << bits[t % 6] << "-bit coefficients." << endl;
+		else
+			n_correct++;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// One prime above the bound (BigUnsigned NTT, Montgomery CIOS
+// above 64 bits) against word NTTs over several primes
+//////////////////////////////////////////////////////////////
+static void benchmark_size(int n, int bits, int n_runs) {
+	typedef chrono::duration<double, milli> ms;
+	vector<BigUnsigned> A = sample_wide(n, bits);
+	vector<BigUnsigned> B = sample_wide(n, bits);
+	int bound = MultiPrimeNTT::boundBits(A, B);
+
+	auto t0 = chrono::steady_clock::now();
+	MultiPrimeNTT plan(2 * n - 1, bound);
+	auto t1 = chrono::steady_clock::now();
+	BigUnsigned q = next_ntt_prime((BigUnsigned(1) << bound) + 1, 2 * plan.vec_length);
+	if (q.isZero())
+		return;     // prime search cancelled
+	NTT ntt(plan.vec_length, q, RNS(), true);
+	auto t2 = chrono::steady_clock::now();
+
+	vector<BigUnsigned> C_multi, C_single;
+	for (int r = 0; r < n_runs; r++)
+		C_multi = plan.multiply(A, B);
+	auto t3 = chrono::steady_clock::now();
+
+	vector<BigUnsigned> a = A, b = B;
+	a.resize(plan.vec_length);
+	b.resize(plan.vec_length);
+	for (int r = 0; r < n_runs; r++)
+		C_single = (Polynomial(a, ntt, Polynomial::CYCLIC) * Polynomial(b, ntt, Polynomial::CYCLIC)).coefficients();
+	auto t4 = chrono::steady_clock::now();
+	C_single.resize(2 * n - 1);
+
+	double t_multi  = ms(t3 - t2).count() / n_runs;
+	double t_single = ms(t4 - t3).count() / n_runs;
+	cout << "n = " << n << ", " << bits << "-bit coefficients (bound 2^" << bound << "): " << plan.primes.size() << " x "
+		<< MultiPrimeNTT::PRIME_BITS << "-bit primes " << t_multi << " ms, one " << q.bitLength() << "-bit prime "
+		<< t_single << " ms, " << t_single / t_multi << "x, " << (vectorsAreEqual(C_multi, C_single) ? "identical" : "DIFFERENT")
+		<< " results. Setup: " << ms(t1 - t0).count() << " ms / " << ms(t2 - t1).count() << " ms." << endl;
+}
+
+void multi_prime_benchmark(int n_runs) {
+	cout << endl << endl << "Multi-prime NTT benchmark (" << PolyMatrix::threadCount() << " threads, " << n_runs << " products each):" << endl;
+
+	const int lengths[] = { 256, 1024 };
+	const int bits[]    = { 32, 128, 512 };
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 3; j++)
+			benchmark_size(lengths[i], bits[j], n_runs);
+	}
+	cout << endl;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <mutex>
+#include "StaticNTT.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Exact integer polynomial multiplication with word-sized NTTs
+//
+// The coefficients of A * B over the integers are below
+//     bound = min(|A|, |B|) * max(A) * max(B)
+// A MultiPrimeNTT for products of up to max_length coefficients
+// with bound < 2^bound_bits takes enough PRIME_BITS-bit primes
+// p = 1 mod 2N (RNS::determineNTTprimes, N the transform length)
+// for their product to exceed the bound, multiplies A and B modulo
+// each prime with a cyclic word NTT of length N >= |A| + |B| - 1
+// (no wrap-around, so the residues are those of the integer
+// product), and puts each coefficient back together with Garner's
+// mixed radix conversion.
+//
+// forwardConverter_polynomial and reverseConverter_polynomial
+// have the semantics of the RNS ones with base = primes (one
+// vector of residues per coefficient); the reverse one uses the
+// precomputed Garner constants instead of CRT weights and a
+// reduction by the dynamic range.
+//
+// Against one NTT over a prime above the bound, every transform
+// works on machine words, whatever the size of the coefficients;
+// only the conversions touch BigUnsigned.
+//////////////////////////////////////////////////////////////
+class MultiPrimeNTT
+{
+
+public:
+	typedef static_ntt::word word;
+
+	static const int PRIME_BITS = 62;     // below 2^63 for static_ntt::redc
+
+	MultiPrimeNTT() : vec_length(0), max_length(0), bound_bits(0) {}
+	MultiPrimeNTT(int max_length, int bound_bits);
+
+	int vec_length;                       // transform length N, a power of two
+	int max_length;                       // |A| + |B| - 1 at most
+	int bound_bits;
+	std::vector<BigUnsigned> primes;
+	BigUnsigned dynamic_range;            // product of the primes
+
+	// Integer product, A.size() + B.size() - 1 coefficients
+	std::vector<BigUnsigned> multiply(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B) const;
+
+	// Plans (once per N and number of primes) and multiplies
+	static std::vector<BigUnsigned> exactProduct(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B);
+	static int boundBits(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B);
+
+	std::vector<std::vector<BigUnsigned>> forwardConverter_polynomial(const std::vector<BigUnsigned>& A) const;
+	std::vector<BigUnsigned> reverseConverter_polynomial(const std::vector<std::vector<BigUnsigned>>& A_rns) const;
+
+	static bool multiPrimeTest(int n_tests);
+
+private:
+	struct Channel {
+		word q, q_inv;
+		word block_shift;                 // 2^BigUnsigned::N, Montgomery form
+		word scale;                       // N^-1 * 2^128, undoes N and one Montgomery factor
+		std::vector<word> forward_twiddles, inverse_twiddles;
+		std::vector<word> garner;         // primes[j]^-1 mod q for j < this channel, Montgomery form
+	};
+	std::vector<Channel> channels;
+
+	static std::map<std::pair<int, int>, MultiPrimeNTT> plans;   // by (N, number of primes)
+	static std::mutex lock;
+
+	BigUnsigned garner(const word* x) const;     // x[c] = residue mod primes[c]
+};
+
+// Exact products against one NTT over a single prime above the bound
+void multi_prime_benchmark(int n_runs = 5);
@@ -2,8 +2,12 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
 #include "general_functions.h"
 #include "RNS.h"
+#include "primality.h"
+#include "ParameterCache.h"
+#include "ParameterCatalog.h"
 #include "BigIntLibrary/BigIntegerLibrary.hh"
 #include <fstream>
 #include <iomanip>
@@ -52,9 +56,11 @@ vector<BigUnsigned> NTT::mult_by_power(vector<BigUnsigned> vec, BigUnsigned val,
 ///////////////////////////////////////////////////////////////
 vector<BigUnsigned> NTT::generate_phi_table(BigUnsigned n, BigUnsigned phi, BigUnsigned modulus) {
     vector<BigUnsigned> table;
+    BigUnsigned power = 1;
 
     for (BigUnsigned i = 0; i < n / 2; i++) {
-        table.push_back(pow_mod(phi, i, modulus));
+        table.push_back(power);
+        power.mulmod(power, phi, modulus);
     }
 
     return table;//bitReverse(table);
@@ -64,51 +70,47 @@ vector<BigUnsigned> NTT::generate_phi_table(BigUnsigned n, BigUnsigned phi, BigU
 ////////////////////////////////////////////////////////////////////////////////
 BigUnsigned NTT::new_modulus(BigUnsigned vec_length, BigUnsigned min_modulus) {
 
-    BigUnsigned k = (min_modulus - 1) / vec_length;  // should be floored,,, starting value to start the new_modulus off close to >= min_modulus
-    BigUnsigned new_modulus = k * vec_length + 1;
-
-    //increment k until modulus is prime and greater than the minimum modulus
-    while ((new_modulus < min_modulus) || (factorize(new_modulus).size() > 1)) {
-        k++;
-        new_modulus = k * vec_length + 1;
-    }
-
-    return new_modulus;
+    //smallest k * 2 * vec_length + 1 that is prime and >= min_modulus (Miller-Rabin / BPSW),
+    //so the 2nth root of unity phi exists
+    return next_ntt_prime(min_modulus, vec_length * 2);
 }
 
 ///////////////////////////////////////////////////////////////
 // Tests to find the nth root of unity
 ///////////////////////////////////////////////////////////////
 BigUnsigned NTT::find_root_of_unity(BigUnsigned vec_length, BigUnsigned modulus) {
-    //Get factors of n (vec_length)
-    vector<BigUnsigned> factors = factorize(vec_length);
-
-    //remove reaccuring factors
-    sort(factors.begin(), factors.end());
-    factors.erase(unique(factors.begin(), factors.end()), factors.end());
+    //Get distinct factors of n (vec_length), once
+    vector<BigUnsigned> factors = prime_factors(vec_length);
 
+    // 0: no nth root of unity unless n divides modulus - 1
+    BigUnsigned totient = modulus - 1;
+    if (!(totient % vec_length).isZero())
+        return 0;
 
-    for (BigUnsigned a = 1; a <= modulus; a++) {
-        //test 1
-        bool flag1 = (pow_mod(a, vec_length, modulus) == 1);
+    //a^((q-1)/n) is always an nth root of unity, so only test 2 is needed
+    for (BigUnsigned a = 2; a < modulus; a++) {
+        BigUnsigned root = pow_mod(a, totient / vec_length, modulus);
 
         //test 2: try for each prime factor of n
-        bool flag2 = all_of(factors.begin(), factors.end(), [&](BigUnsigned prime) {return pow_mod(a, vec_length / prime, modulus) != 1; });
+        bool flag2 = all_of(factors.begin(), factors.end(), [&](BigUnsigned prime) {return pow_mod(root, vec_length / prime, modulus) != 1; });
 
-        if (flag2 && flag1)
-            return a;
+        if (flag2)
+            return root;
     }
  
     //error
-    return -1;
+    return 0;
 }
 
 ///////////////////////////////////////////////////////////////
 // Find generator
 ///////////////////////////////////////////////////////////////
 bool NTT::is_generator(BigUnsigned val, BigUnsigned totient, BigUnsigned mod) {
-    vector<BigUnsigned> factors = factorize(totient);
+    return is_generator(val, totient, mod, prime_factors(totient));
+}
 
+// factors: distinct prime factors of totient, so a search only factors it once
+bool NTT::is_generator(BigUnsigned val, BigUnsigned totient, BigUnsigned mod, const vector<BigUnsigned>& factors) {
     //test 1
     bool flag1 = (pow_mod(val, totient, mod) == 1);
 
@@ -119,32 +121,56 @@ bool NTT::is_generator(BigUnsigned val, BigUnsigned totient, BigUnsigned mod) {
 }
 
 BigUnsigned NTT::find_generator(BigUnsigned totient, BigUnsigned mod) {
+    vector<BigUnsigned> factors = prime_factors(totient);
+
     for (BigUnsigned i = 1; i < mod; i++) {
-        if (is_generator(i, totient, mod)) {
+        if (is_generator(i, totient, mod, factors)) {
             return i;
         }
     }
+
+    cout << "ERROR: no generator found mod " << mod << "." << endl;
+    return 0;
 }
 ///////////////////////////////////////////////////////////////
 // Tests to find the nth root of unity with generator
 ///////////////////////////////////////////////////////////////
+// A generator is not needed: a^((q-1)/n) is primitive as soon as it
+// passes the tests for the prime factors of n, so q-1 is never factored.
     BigUnsigned NTT::find_root_of_unity2(BigUnsigned degree, BigUnsigned mod) {
-    BigUnsigned totient = mod - 1;
-    BigUnsigned generator = find_generator(totient, mod);
-    BigUnsigned root = pow_mod(generator, totient / degree, mod);
-    return root;
+    return find_root_of_unity(degree, mod);
 }
 
 ///////////////////////////////////////////////////////////////
 // Solve all parameters
+// Empty if modulus has no 2nth root of unity or the search for
+// it was cancelled.
 ///////////////////////////////////////////////////////////////
 vector<BigUnsigned> NTT::solveParameters(BigUnsigned vector_length, BigUnsigned minimum_modulus, bool modulusIsPrimeIPromise) {
     BigUnsigned modulus_local = minimum_modulus;
     if (modulusIsPrimeIPromise == false)
         modulus_local = NTT::new_modulus(vector_length, minimum_modulus);             // Used modulus
-    BigUnsigned w_n_local = find_root_of_unity2(vector_length, modulus_local);        // nth root of unity
+    if (modulus_local < 2)
+        return vector<BigUnsigned>();                                                 // prime search cancelled (reported there)
+
+    // phi is found directly as a primitive 2nth root and w_n = phi^2. Only a
+    // promised modulus can have 2n not dividing modulus - 1; phi is then a
+    // square root of w_n, which only exists if w_n is a quadratic residue.
+    BigUnsigned phi_local, w_n_local;
+    if (((modulus_local - 1) % (vector_length * 2)).isZero()) {
+        phi_local = find_root_of_unity(vector_length * 2, modulus_local);             // 2nth root of unity
+        w_n_local.mulmod(phi_local, phi_local, modulus_local);                        // nth root of unity
+    }
+    else {
+        w_n_local = find_root_of_unity2(vector_length, modulus_local);
+        if (!w_n_local.isZero() && jacobi_symbol(w_n_local, modulus_local) == 1)
+            phi_local = sqrt_mod(w_n_local, modulus_local);
+    }
+    if (phi_local.isZero() || w_n_local.isZero()) {
+        cout << "ERROR: no " << vector_length * 2 << "th root of unity mod " << modulus_local << "." << endl;
+        return vector<BigUnsigned>();
+    }
     BigUnsigned w_n_inv_local = mod_inverse(w_n_local, modulus_local);                // root inverse
-    BigUnsigned phi_local = sqrt_mod(w_n_local, modulus_local);
     BigUnsigned phi_inv_local = mod_inverse(phi_local, modulus_local);
 
     return vector<BigUnsigned> {modulus_local, w_n_local, w_n_inv_local, phi_local, phi_inv_local};
@@ -220,11 +246,33 @@ vector<vector<BigUnsigned>> NTT::butterfly_rns(vector<BigUnsigned> left, vector<
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Bit reversed evaluation order
+//
+// With bitreversed set, no vector is permuted. The forward transform takes
+// coefficients in natural order and runs the stages from size n down to 2:
+// block b of every stage splits x^2h - c into x^h -/+ sqrt(c), which is one
+// Cooley-Tukey butterfly per pair with the twiddle w^bitrev(b) (b reversed
+// over log2(n) - 1 bits). The leaves come out as index i = a(w^bitrev(i)),
+// the natural output with its indices reversed. The inverse transform takes
+// that order, which is what the usual stages expect after bitReverse, and
+// returns coefficients in natural order.
+///////////////////////////////////////////////////////////////////////////////
+static int reverse_bits(int x, int n_bits) {
+    int r = 0;
+    for (int j = 0; j < n_bits; j++, x >>= 1)
+        r = (r << 1) | (x & 1);
+    return r;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // NTT 
 // Based on Nayuki radix2 
 ///////////////////////////////////////////////////////////////////////////////
-vector<BigUnsigned> NTT::calculate(vector<BigUnsigned> A, bool inverse) {
+vector<BigUnsigned> NTT::calculate(vector<BigUnsigned> A, bool inverse, bool bitreversed) {
+    if (USE_CIOS)
+        return calculate_cios(A, inverse, bitreversed);
+
     int n = A.size();
     int levels = log2(n);
 
@@ -241,7 +289,22 @@ vector<BigUnsigned> NTT::calculate(vector<BigUnsigned> A, bool inverse) {
         temp = (temp * omeg) % modulus;
     }
 
-    A = bitReverse(A);
+    if (bitreversed && !inverse) {
+        for (int halfsize = n / 2; halfsize >= 1; halfsize /= 2) {
+            for (int i = 0, b = 0; i < n; i += 2 * halfsize, b++) {
+                const BigUnsigned& twiddle = powtable[reverse_bits(b, levels - 1)];
+                for (int start = i; start < i + halfsize; start++) {
+                    vector<BigUnsigned> bf = rns.butterfly(A[start], A[start + halfsize], twiddle, modulus);
+                    A[start]            = bf[0];
+                    A[start + halfsize] = bf[1];
+                }
+            }
+        }
+        return A;
+    }
+
+    if (!bitreversed)
+        A = bitReverse(A);
 
     int size = 2;
     int count = 0;
@@ -277,6 +340,91 @@ vector<BigUnsigned> NTT::calculate(vector<BigUnsigned> A, bool inverse) {
     return A;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// NTT 
+// Based on Nayuki radix2, with CIOS Montgomery multiplication
+
+// Used by calculate() for moduli wider than 64 bits. The vector is held as
+// n_words machine words per value in Montgomery form for the whole transform
+// and only converted back to BigUnsigned at the end. This is the non-RNS
+// baseline for calculate_rns().
+///////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> NTT::calculate_cios(vector<BigUnsigned> A, bool inverse, bool bitreversed) {
+    typedef MontgomeryCIOS::word word;
+    int n = A.size();
+    int levels = log2(n);
+    int s = cios.n_words;
+
+    vector<word> a(n * s), powtable((n / 2) * s);
+    word omeg[MontgomeryCIOS::MAX_WORDS], product[MontgomeryCIOS::MAX_WORDS];
+
+    // twiddle factors in Montgomery form
+    cios.toWords(inverse ? w_n_inv : w_n, omeg);
+    cios.toMontgomery(omeg, omeg);
+    for (int j = 0; j < s; j++)
+        powtable[j] = cios.one[j];
+    for (int i = 1; i < n / 2; i++)
+        cios.mult(&powtable[i * s], &powtable[(i - 1) * s], omeg);
+
+    if (!bitreversed)
+        A = bitReverse(A);
+    for (int i = 0; i < n; i++) {
+        if (A[i] >= modulus)
+            A[i] %= modulus;
+        cios.toWords(A[i], &a[i * s]);
+        cios.toMontgomery(&a[i * s], &a[i * s]);
+    }
+
+    int size = 2;
+
+    if (bitreversed && !inverse) {
+        size = n + 1;   // the stages in reverse instead
+        for (int halfsize = n / 2; halfsize >= 1; halfsize /= 2) {
+            for (int i = 0, b = 0; i < n; i += 2 * halfsize, b++) {
+                const word* twiddle = &powtable[reverse_bits(b, levels - 1) * s];
+                for (int start = i; start < i + halfsize; start++) {
+                    int end = start + halfsize;
+
+                    cios.mult(product, &a[end * s], twiddle);
+                    cios.sub(&a[end * s], &a[start * s], product);
+                    cios.add(&a[start * s], &a[start * s], product);
+                }
+            }
+        }
+    }
+
+    while (size <= n) {
+        int halfsize = size / 2;
+        int tablestep = n / size;
+
+        for (int i = 0; i < n; i += size) {
+            int  k = 0;
+            for (int start = i; start < i + halfsize; start++) {
+                int end = start + halfsize;
+
+                cios.mult(product, &a[end * s], &powtable[k * s]);
+                cios.sub(&a[end * s], &a[start * s], product);
+                cios.add(&a[start * s], &a[start * s], product);
+
+                k += tablestep;
+            }
+        }
+        size += size;  // size = size * 2
+    }
+
+    // Leaving Montgomery form is a product with 1. For the inverse the
+    // product is with n^-1 instead, which scales and converts in one go.
+    word scale[MontgomeryCIOS::MAX_WORDS] = { 1 };
+    if (inverse)
+        cios.toWords(mod_inverse(n, modulus), scale);
+
+    for (int i = 0; i < n; i++) {
+        cios.mult(&a[i * s], &a[i * s], scale);
+        A[i] = cios.fromWords(&a[i * s]);
+    }
+    return A;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // NTT 
 // Based on Nayuki radix2, with RNS 
@@ -284,30 +432,61 @@ vector<BigUnsigned> NTT::calculate(vector<BigUnsigned> A, bool inverse) {
 // The function rns.mult(a,b) uses the chosen RNS to multiply. That RNS
 // uses montgomery reduction internally as long as the rns modulus is odd.
 ///////////////////////////////////////////////////////////////////////////////
-vector<vector<BigUnsigned>> NTT::calculate_rns(vector<vector<BigUnsigned>> A, bool inverse) {
+vector<vector<BigUnsigned>> NTT::calculate_rns(vector<vector<BigUnsigned>> A, bool inverse, bool bitreversed) {
     int n      = A.size();
     int levels = log2(n);
 
+    // Twiddle factors are reduced mod modulus before conversion, like the
+    // table of calculate() and the one save_twiddle_table writes for the
+    // hardware. Chaining modmult_RNS would leave w_n^k unreduced, which
+    // outgrows the dynamic range within a few powers.
     vector<vector<BigUnsigned>> powtable;
 
-    vector<BigUnsigned> temp = rns.forwardConverter(1, rns.bases);
-    vector<BigUnsigned> omeg = rns.forwardConverter(w_n, rns.bases);
-    
+    BigUnsigned temp = 1;
+    BigUnsigned omeg = w_n;
+
     if (inverse)
-        omeg = rns.forwardConverter(w_n_inv, rns.bases);
+        omeg = w_n_inv;
 
     for (int i = 0; i < n / 2; i++) {
-        powtable.push_back(temp);
-        temp = rns.modmult_RNS(temp, omeg);
+        powtable.push_back(rns.forwardConverter(temp, rns.bases));
+        temp.mulmod(temp, omeg, modulus);
     }
 
-    A = bitReverse_rns(A);
+    if (!bitreversed)
+        A = bitReverse_rns(A);
 
     int size  = 2;
     int count = 0;
 
     bool flag1, flag2;
 
+    if (bitreversed && !inverse) {
+        size = n + 1;   // the stages in reverse instead, the last one has halfsize 1
+        for (int halfsize = n / 2; halfsize >= 1; halfsize /= 2) {
+            if ((halfsize == 1) && (CORRECT_LAST_NTT_RUN)) {
+                flag1 = rns.MULTIPLY_MODMULT_INPUT_BY_D;
+                flag2 = rns.CORRECT_MODMULT_OUTPUT;
+
+                rns.MULTIPLY_MODMULT_INPUT_BY_D = true;
+                rns.CORRECT_MODMULT_OUTPUT      = true;
+            }
+
+            for (int i = 0, b = 0; i < n; i += 2 * halfsize, b++) {
+                const vector<BigUnsigned>& twiddle = powtable[reverse_bits(b, levels - 1)];
+                for (int start = i; start < i + halfsize; start++) {
+                    ScratchArena::Scope scratch;
+
+                    vector<vector<BigUnsigned>> bf = rns.butterfly_rns(A[start], A[start + halfsize], twiddle);
+
+                    ScratchArena::Suspend heap;
+                    A[start]            = bf[0];
+                    A[start + halfsize] = bf[1];
+                }
+            }
+        }
+    }
+
     while (size <= n) {
         int halfsize = size / 2;
         int tablestep = n / size;
@@ -330,8 +509,13 @@ vector<vector<BigUnsigned>> NTT::calculate_rns(vector<vector<BigUnsigned>> A, bo
             for (int start = i; start < i + halfsize; start++) {
                 int end = start + halfsize;
 
+                // all temporaries of the butterfly come from the scratch arena,
+                // which is rewound when it ends
+                ScratchArena::Scope scratch;
+
                 vector<vector<BigUnsigned>> bf = rns.butterfly_rns(A[start], A[end], powtable[k]);
 
+                ScratchArena::Suspend heap;   // A outlives the butterfly
                 A[start] = bf[0];
                 A[end]   = bf[1];
 
@@ -357,11 +541,28 @@ vector<vector<BigUnsigned>> NTT::calculate_rns(vector<vector<BigUnsigned>> A, bo
     return A;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Range calculate_rns needs
+//
+// modmult_RNS with MULTIPLY_MODMULT_INPUT_BY_D returns the product itself,
+// not its residue, and the butterflies only reduce on the last stage. The
+// left outputs therefore grow by a factor q + 1 per stage, and for inputs
+// below q the largest product formed is q^2 (q + 1)^(log2(n) - 1). It has
+// to be below D2, the product of base2, or it wraps around.
+///////////////////////////////////////////////////////////////////////////////
+BigUnsigned NTT::rnsRangeNeeded(BigUnsigned vector_length, BigUnsigned modulus) {
+    BigUnsigned range = modulus * modulus;
+    for (BigUnsigned size = 4; size <= vector_length; size *= 2)
+        range *= modulus + 1;
+    return range;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Tests RNS NTT versus standard NTT
 /////////////////////////////////////////////////////////////////////////////
 void NTT::NTT_test(int n_tests) {
     int n_correct = 0;
+    unsigned long allocations = BigUnsigned::getAllocationCount();
     cout << endl << endl << "NTT TEST:" << endl << endl;
     for (int i = 0; i < n_tests; i++) {
         cout << "TEST " << i << ":" << endl;
@@ -404,7 +605,101 @@ void NTT::NTT_test(int n_tests) {
        
     }
 
-    cout << n_correct << "/" << n_tests << " tests correct." << endl << endl;
+    allocations = BigUnsigned::getAllocationCount() - allocations;
+
+    cout << n_correct << "/" << n_tests << " tests correct." << endl;
+    cout << allocations << " BigUnsigned heap block allocations (" << allocations / n_tests << " per test)." << endl << endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Tests the bit reversed order against the natural one: the forward
+// transforms give the natural output with the indices reversed, the
+// inverse ones give the polynomial back. Plain, CIOS (when it supports
+// the modulus) and RNS are counted separately. RNS is only tested when
+// base2 covers rnsRangeNeeded(); an RNS result that disagrees with the
+// plain one, in either order, is a failure. Also times a multiplication
+// both ways.
+/////////////////////////////////////////////////////////////////////////////
+bool NTT::bitReversedTest(int n_tests) {
+    typedef chrono::duration<double, milli> ms;
+    int n_plain = 0, n_cios = 0, n_rns = 0;
+    int n = vec_length.toInt();
+    int n_bits = log2(n);
+    double t_natural = 0, t_bitreversed = 0;
+
+    // CIOS is also tested on moduli the NTT would not use it for
+    bool use_cios  = USE_CIOS;
+    bool test_cios = MontgomeryCIOS::supports(modulus);
+    MontgomeryCIOS cios_used = cios;
+    if (test_cios && !use_cios)
+        cios = MontgomeryCIOS(modulus);
+
+    bool test_rns = !rns.bases.empty() && rnsRangeNeeded(vec_length, modulus) < rns.D2;
+
+    for (int t = 0; t < n_tests; t++) {
+        vector<BigUnsigned> A = sample_polynomial(vec_length, modulus);
+        vector<BigUnsigned> B = sample_polynomial(vec_length, modulus);
+
+        USE_CIOS = use_cios;
+        auto t0 = chrono::steady_clock::now();
+        vector<BigUnsigned> C = calculate(hadamard_product(calculate(A), calculate(B), modulus), true);
+        auto t1 = chrono::steady_clock::now();
+        vector<BigUnsigned> D = calculate(hadamard_product(calculate(A, false, true), calculate(B, false, true), modulus), true, true);
+        auto t2 = chrono::steady_clock::now();
+        t_natural     += ms(t1 - t0).count();
+        t_bitreversed += ms(t2 - t1).count();
+
+        USE_CIOS = false;
+        vector<BigUnsigned> E = calculate(A);
+        for (int mode = 0; mode < (test_cios ? 2 : 1); mode++) {
+            USE_CIOS = (mode == 1);
+            vector<BigUnsigned> F = calculate(A, false, true);
+            bool correct = vectorsAreEqual(calculate(F, true, true), A);
+            for (int j = 0; j < n && correct; j++)
+                correct = (F[j] == E[reverse_bits(j, n_bits)]);
+            if (mode == 0)
+                correct = correct && vectorsAreEqual(C, D);
+            if (correct && mode == 0)
+                n_plain++;
+            if (correct && mode == 1)
+                n_cios++;
+        }
+
+        // calculate_rns leaves values above q, so Z is reduced and converted
+        // again before the inverse, as between two transforms in a product
+        if (test_rns) {
+            vector<BigUnsigned> E_rns = rns.reverseConverter_polynomial(calculate_rns(rns.forwardConverter_polynomial(A, rns.bases)), rns.bases);
+            vector<BigUnsigned> Z = rns.reverseConverter_polynomial(calculate_rns(rns.forwardConverter_polynomial(A, rns.bases), false, true), rns.bases);
+            bool correct = true;
+            for (int j = 0; j < n; j++) {
+                E_rns[j] %= modulus;
+                Z[j] %= modulus;
+                correct = correct && (E_rns[j] == E[j]) && (Z[j] == E[reverse_bits(j, n_bits)]);
+            }
+            vector<BigUnsigned> Y = rns.reverseConverter_polynomial(calculate_rns(rns.forwardConverter_polynomial(Z, rns.bases), true, true), rns.bases);
+            for (int j = 0; j < n; j++)
+                Y[j] %= modulus;
+            if (correct && vectorsAreEqual(Y, A))
+                n_rns++;
+        }
+    }
+
+    USE_CIOS = use_cios;
+    cios     = cios_used;
+
+    cout << "Multiplication: " << t_natural / n_tests << " ms in natural order, " << t_bitreversed / n_tests << " ms in bit reversed order." << endl;
+    cout << "Plain: " << n_plain << "/" << n_tests << " tests correct." << endl;
+    if (test_cios)
+        cout << "CIOS: " << n_cios << "/" << n_tests << " tests correct." << endl;
+    else
+        cout << "CIOS: not tested, the modulus is even or too wide." << endl;
+    if (rns.bases.empty())
+        cout << "RNS: not tested, no RNS bases." << endl;
+    else if (!test_rns)
+        cout << "RNS: not tested, base2 is smaller than rnsRangeNeeded()." << endl;
+    else
+        cout << "RNS: " << n_rns << "/" << n_tests << " tests correct." << endl;
+    return n_plain == n_tests && (!test_cios || n_cios == n_tests) && (!test_rns || n_rns == n_tests);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -434,14 +729,107 @@ NTT::NTT(BigUnsigned vector_length, BigUnsigned minimum_modulus, RNS rns_system,
     min_mod    = minimum_modulus;
     rns        = rns_system;
 
-    vector<BigUnsigned> params = solveParameters(vector_length, minimum_modulus, modulusIsPrimeIPromise);
-    modulus = params[0];
-    w_n     = params[1];
-    w_n_inv = params[2];
-    phi     = params[3];
-    phi_inv = params[4];
+    // modulus, roots and phi table from an earlier run, or solved now and saved
+    if (!ParameterCache::load(*this, modulusIsPrimeIPromise)) {
+        vector<BigUnsigned> params = solveParameters(vector_length, minimum_modulus, modulusIsPrimeIPromise);
+        if (params.empty())
+            return;     // no parameters (modulus 0), as NTT()
+        modulus = params[0];
+        w_n     = params[1];
+        w_n_inv = params[2];
+        phi     = params[3];
+        phi_inv = params[4];
+
+        phi_table = generate_phi_table(vector_length, phi, modulus);    // bit reversed powers of phi
+        ParameterCache::save(*this, modulusIsPrimeIPromise);
+    }
+    n_inv = mod_inverse(vector_length, modulus);
+
+    // Word-level Montgomery replaces BigUnsigned % for wide moduli
+    if (modulus.bitLength() > 64 && MontgomeryCIOS::supports(modulus)) {
+        cios     = MontgomeryCIOS(modulus);
+        USE_CIOS = true;
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// NTT from the parameter catalog
+// No parameter search at all: the catalog's modulus, roots and
+// RNS bases are used as they are. Bases that initializeParameters
+// refuses leave the NTT without an RNS path (no rns.bases).
+///////////////////////////////////////////////////////////////
+NTT NTT::fromCatalog(string name) {
+    NTT ntt;
+    ParameterCatalog::Parameters p;
+    if (!ParameterCatalog::lookup(name, p)) {
+        cout << "ERROR: no parameter set named " << name << " in the catalog." << endl;
+        return ntt;
+    }
 
-    phi_table = generate_phi_table(vector_length, phi, modulus);    // bit reversed powers of phi
+    ntt.vec_length = p.n;
+    ntt.min_mod    = p.modulus;
+    ntt.modulus    = p.modulus;
+    ntt.w_n        = p.w_n;
+    ntt.w_n_inv    = p.w_n_inv;
+    ntt.phi        = p.phi;
+    ntt.phi_inv    = p.phi_inv;
+    ntt.n_inv      = p.n_inv;
+    ntt.phi_table  = generate_phi_table(p.n, p.phi, p.modulus);
+    if (!ntt.rns.initializeParameters(p.rns_bases, p.modulus)) {
+        cout << "ERROR: RNS bases of " << name << " refused, calculate_rns is not available." << endl;
+        ntt.rns = RNS();
+    }
+
+    if (ntt.modulus.bitLength() > 64 && MontgomeryCIOS::supports(ntt.modulus)) {
+        ntt.cios     = MontgomeryCIOS(ntt.modulus);
+        ntt.USE_CIOS = true;
+    }
+    return ntt;
+}
+
+///////////////////////////////////////////////////////////////
+// Automorphisms X -> X^k in evaluation form
+//
+// calculate() leaves a(w_n^j) at index j; in the negacyclic ring the
+// scaling by powers of phi makes that a(phi^(2j+1)). As
+// a(X^k) at a point x is a at x^k, the automorphism only moves values:
+//   negacyclic: index j takes the value at (k(2j+1) mod 2n - 1) / 2
+//   cyclic:     index j takes the value at kj mod n
+// There are no sign flips (those only appear in coefficient form), and
+// the same map serves every representation with the same ordering. In
+// bit reversed order both sides of the map have their indices reversed.
+///////////////////////////////////////////////////////////////
+const vector<int>& NTT::automorphismMap(int k, bool negacyclic, bool bitreversed) const {
+    static const vector<int> none;
+    long long n = vec_length.toInt();
+    long long m = negacyclic ? 2 * n : n;
+    long long k_red = ((k % m) + m) % m;
+
+    long long a = k_red, b = m;                 // gcd(k, m), the map is a permutation only for 1
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    if (n == 0 || a != 1) {
+        cout << "ERROR: X -> X^" << k << " is not an automorphism of Z_q[x]/(x^" << n << (negacyclic ? " + 1)." : " - 1).") << endl;
+        return none;
+    }
+
+    pair<int, int> key((int)k_red, negacyclic + 2 * bitreversed);
+    lock_guard<mutex> guard(automorphism_maps.lock);
+    map<pair<int, int>, vector<int>>::iterator it = automorphism_maps.maps.find(key);
+    if (it == automorphism_maps.maps.end()) {
+        int n_bits = log2(n);
+        vector<int> index(n);
+        for (long long j = 0; j < n; j++) {
+            long long i = bitreversed ? reverse_bits((int)j, n_bits) : j;
+            int to = negacyclic ? (int)((k_red * (2 * i + 1) % m - 1) / 2) : (int)(k_red * i % m);
+            index[j] = bitreversed ? reverse_bits(to, n_bits) : to;
+        }
+        it = automorphism_maps.maps.insert(make_pair(key, index)).first;
+    }
+    return it->second;
 }
 
 /*
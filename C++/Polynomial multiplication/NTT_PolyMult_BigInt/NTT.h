@@ -1,6 +1,29 @@
 #pragma once
 #include <vector>
+#include <string>
+#include <map>
+#include <mutex>
 #include "RNS.h"
+#include "MontgomeryCIOS.h"
+
+// Index maps of the automorphisms X -> X^k in evaluation form, built by
+// NTT::automorphismMap on first use. Lookups take the lock; std::map
+// entries never move, so a map handed out stays valid as others are added.
+struct AutomorphismMaps
+{
+	std::map<std::pair<int, int>, std::vector<int>> maps;   // by (k mod 2n or n, negacyclic + 2 * bitreversed)
+	mutable std::mutex lock;
+
+	AutomorphismMaps() {}
+	AutomorphismMaps(const AutomorphismMaps& other) { *this = other; }
+	AutomorphismMaps& operator=(const AutomorphismMaps& other) {
+		if (this != &other) {
+			std::lock_guard<std::mutex> guard(other.lock);
+			maps = other.maps;
+		}
+		return *this;
+	}
+};
 
 class NTT
 {
@@ -12,30 +35,51 @@ class NTT
 		BigUnsigned w_n_inv;     // modular inverse of w_n.
 		BigUnsigned phi;         // phi^2 = w_n
 		BigUnsigned phi_inv;
+		BigUnsigned n_inv;       // n^-1 mod modulus
 
 		RNS rns;
+		MontgomeryCIOS cios;     // word-level Montgomery for moduli wider than 64 bits
+		bool USE_CIOS = false;   // set by the constructor when cios supports the modulus
 
 		bool CORRECT_LAST_NTT_RUN = true; // corrects modmult output to be exact on the last stage
 
 		BigUnsigned vec_length;  //  Size of the transform and "n" in the nth root of unity.
 		std::vector<BigUnsigned> phi_table; //bit reversed powers of phi
+		mutable AutomorphismMaps automorphism_maps;
 		
 		NTT(BigUnsigned vector_length, BigUnsigned minimum_modulus, RNS RNS_system, bool modulusIsPrimeIPromise = false);   //constructor
+		NTT() {}
+		static NTT fromCatalog(std::string name);   // precomputed parameters and RNS bases, see ParameterCatalog.h
 		
 		static BigUnsigned new_modulus(BigUnsigned vec_length, BigUnsigned min_modulus);
-		std::vector<BigUnsigned> calculate(std::vector<BigUnsigned> A, bool inverse = false);
-		std::vector<std::vector<BigUnsigned>> calculate_rns(std::vector<std::vector<BigUnsigned>> A, bool inverse = false);
+
+		// bitreversed: the forward transform leaves a(w_n^bitrev(j)) at index j and
+		// the inverse one expects that order; neither permutes the vector. Pointwise
+		// operations (hadamard_product, modmult_RNS) do not care about the order.
+		std::vector<BigUnsigned> calculate(std::vector<BigUnsigned> A, bool inverse = false, bool bitreversed = false);
+		std::vector<BigUnsigned> calculate_cios(std::vector<BigUnsigned> A, bool inverse = false, bool bitreversed = false);
+		std::vector<std::vector<BigUnsigned>> calculate_rns(std::vector<std::vector<BigUnsigned>> A, bool inverse = false, bool bitreversed = false);
 		std::vector<BigUnsigned> stupidcalculate(std::vector<BigUnsigned> A, bool inverse = false);
+
+		// X -> X^k applied to an evaluation (output of calculate, or calculate_rns,
+		// or a word copy of either): out[j] = evaluation[map[j]], no transform.
+		// k must be odd in the negacyclic ring, coprime to n in the cyclic one;
+		// otherwise the map is empty. bitreversed for evaluations in that order.
+		const std::vector<int>& automorphismMap(int k, bool negacyclic = true, bool bitreversed = false) const;
+		template<typename T> std::vector<T> automorphism(const std::vector<T>& evaluation, int k, bool negacyclic = true, bool bitreversed = false) const;
 		static BigUnsigned find_root_of_unity2(BigUnsigned vec_length, BigUnsigned modulus);
+		static BigUnsigned rnsRangeNeeded(BigUnsigned vector_length, BigUnsigned modulus);   // base2 of the RNS has to exceed it for calculate_rns
 		
 		void NTT_test(int n_tests);
+		bool bitReversedTest(int n_tests);
 		std::vector<BigUnsigned> static solveParameters(BigUnsigned vector_length, BigUnsigned mod, bool modulusIsPrimeIPromse = false);
 		void printParameters();
 
 	//private:
 		static bool is_generator(BigUnsigned val, BigUnsigned totient, BigUnsigned mod);
+		static bool is_generator(BigUnsigned val, BigUnsigned totient, BigUnsigned mod, const std::vector<BigUnsigned>& factors);
 		static BigUnsigned find_generator(BigUnsigned totient, BigUnsigned mod);
-		BigUnsigned find_root_of_unity(BigUnsigned vec_length, BigUnsigned modulus);
+		static BigUnsigned find_root_of_unity(BigUnsigned vec_length, BigUnsigned modulus);
 		std::vector<BigUnsigned> constant_vector(BigUnsigned length, BigUnsigned val);
 		std::vector<BigUnsigned> mult_by_power(std::vector<BigUnsigned> in, BigUnsigned val, BigUnsigned modulus);
 		std::vector<BigUnsigned> static generate_phi_table(BigUnsigned n, BigUnsigned w_n, BigUnsigned modulus);
@@ -45,6 +89,18 @@ class NTT
 
 };
 
+template<typename T>
+std::vector<T> NTT::automorphism(const std::vector<T>& evaluation, int k, bool negacyclic, bool bitreversed) const {
+	const std::vector<int>& map = automorphismMap(k, negacyclic, bitreversed);
+	if (map.empty() || map.size() != evaluation.size())
+		return std::vector<T>();
+
+	std::vector<T> out(evaluation.size());
+	for (int j = 0; j < map.size(); j++)
+		out[j] = evaluation[map[j]];
+	return out;
+}
+
 void save_twiddle_table(char* savename, BigUnsigned NTT_size, BigUnsigned w_n, BigUnsigned mod);
 
 //void massNTT(int n_tests, BigUnsigned length, BigUnsigned minimum_modulus, std::vector<BigUnsigned> rns_moduli);
@@ -0,0 +1,171 @@
+#include "ParallelSearch.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#include "primality.h"
+#include "RNS.h"
+#include "general_functions.h"
+
+using namespace std;
+
+typedef unsigned long long ull;
+
+unsigned int ParallelSearch::threads = 0;
+atomic<ull> ParallelSearch::cancel_count(0);
+
+void ParallelSearch::cancel() {
+	cancel_count++;
+}
+
+bool ParallelSearch::cancelled(ull count) {
+	return cancel_count.load() != count;
+}
+
+unsigned int ParallelSearch::threadCount() {
+	unsigned int n = (threads != 0) ? threads : thread::hardware_concurrency();
+	return (n != 0) ? n : 1;
+}
+
+unsigned long long ParallelSearch::windowSize() {
+	return ull(WINDOW) * threadCount();
+}
+
+//////////////////////////////////////////////////////////////
+// Search loop
+//
+// Results go into a ring of `window` slots indexed by k; a
+// worker only takes candidate k once k < consumed + window, so
+// its slot has been emptied by the calling thread. A slot is
+// freed after accept() returns, so callers can keep their own
+// per-candidate data in a ring of the same size.
+//////////////////////////////////////////////////////////////
+bool ParallelSearch::run(ull limit, const function<bool(ull)>& test, const function<bool(ull)>& accept) {
+	unsigned int n_threads = threadCount();
+	const ull count = cancel_count.load();     // cancel() calls from now on stop this search
+
+	if (n_threads == 1) {
+		for (ull k = 0; k < limit; k++) {
+			if (cancelled(count))
+				return false;
+			if (test(k) && !accept(k))
+				break;
+		}
+		return true;
+	}
+
+	const ull window = windowSize();
+	enum { PENDING, FAILED, PASSED };
+
+	mutex m;
+	condition_variable ready, advanced;
+	vector<char> state(window, PENDING);
+	ull next     = 0;         // next candidate to hand to a worker
+	ull consumed = 0;         // next candidate to hand to accept()
+	bool stop    = false;
+
+	auto worker = [&]() {
+		while (true) {
+			ull k;
+			{
+				unique_lock<mutex> lock(m);
+				advanced.wait(lock, [&] { return stop || next >= limit || next < consumed + window; });
+				if (stop || next >= limit)
+					return;
+				k = next++;
+			}
+
+			bool pass = !cancelled(count) && test(k);
+			{
+				lock_guard<mutex> lock(m);
+				state[k % window] = pass ? PASSED : FAILED;
+			}
+			ready.notify_one();
+		}
+	};
+
+	vector<thread> workers;
+	for (unsigned int i = 0; i < n_threads; i++)
+		workers.push_back(thread(worker));
+
+	bool completed = true;
+	while (consumed < limit) {
+		unique_lock<mutex> lock(m);
+		while (state[consumed % window] == PENDING && !cancelled(count))
+			ready.wait_for(lock, chrono::milliseconds(10));
+		if (cancelled(count)) {
+			completed = false;
+			break;
+		}
+
+		ull  k    = consumed;
+		bool pass = (state[k % window] == PASSED);
+		lock.unlock();
+
+		bool more = !pass || accept(k);
+
+		// slot k is only reused once accept(k) is done with it
+		lock.lock();
+		state[k % window] = PENDING;
+		consumed++;
+		lock.unlock();
+		advanced.notify_one();
+
+		if (!more)
+			break;
+	}
+
+	{
+		lock_guard<mutex> lock(m);
+		stop = true;
+	}
+	advanced.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	return completed;
+}
+
+//////////////////////////////////////////////////////////////
+// Same searches with 1 and threadCount() threads
+//////////////////////////////////////////////////////////////
+void parallel_search_benchmark() {
+	unsigned int saved_threads = ParallelSearch::threads;
+	unsigned int n_threads     = ParallelSearch::threadCount();
+	if (n_threads < 2)
+		n_threads = 4;     // still checks that the ordered reduction is deterministic
+
+	cout << endl << endl << "Parallel search benchmark (1 versus " << n_threads << " threads):" << endl;
+
+	vector<BigUnsigned> serial[3], parallel[3];
+	double times[3][2];
+	const char* names[3] = { "40 60-bit NTT primes, n = 4096:", "8 120-bit NTT primes, n = 4096:", "determineRNSmoduli2(1024, 16):" };
+
+	for (int run = 0; run < 2; run++) {
+		ParallelSearch::threads = (run == 0) ? 1 : n_threads;
+		vector<BigUnsigned>* results = (run == 0) ? serial : parallel;
+
+		auto t0 = chrono::steady_clock::now();
+		results[0] = RNS::determineNTTprimes(60, 40, 4096);
+		auto t1 = chrono::steady_clock::now();
+		results[1] = RNS::determineNTTprimes(120, 8, 4096, false);
+		auto t2 = chrono::steady_clock::now();
+		results[2] = RNS::determineRNSmoduli2(1024, 16, false);
+		auto t3 = chrono::steady_clock::now();
+
+		times[0][run] = chrono::duration<double, milli>(t1 - t0).count();
+		times[1][run] = chrono::duration<double, milli>(t2 - t1).count();
+		times[2][run] = chrono::duration<double, milli>(t3 - t2).count();
+	}
+	ParallelSearch::threads = saved_threads;
+
+	cout << endl;
+	for (int i = 0; i < 3; i++) {
+		cout << names[i] << " " << times[i][0] << " ms serial, " << times[i][1] << " ms parallel, "
+			<< (vectorsAreEqual(serial[i], parallel[i]) ? "identical" : "DIFFERENT") << " results." << endl;
+	}
+	cout << endl;
+}
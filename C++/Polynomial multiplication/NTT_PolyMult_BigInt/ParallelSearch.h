@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <functional>
+
+//////////////////////////////////////////////////////////////
+// Parallel candidate search
+//
+// run() tests candidates 0, 1, 2, ... (below limit) with test(k)
+// on several threads and hands the ones that pass to accept(k) on
+// the calling thread, strictly in increasing order of k. The
+// result is therefore the same as the serial loop for any number
+// of threads. accept() returning false ends the search. Workers
+// run at most a window of candidates ahead of accept(), so little
+// is tested past the last candidate needed.
+//
+// test() runs concurrently and must only read shared state;
+// accept() runs alone and may update what test() reads for later
+// candidates, but candidates already in the window may have been
+// tested against the old state (check them again in accept()).
+// Candidate k and k + windowSize() are never in flight together,
+// so per-candidate data can live in a ring indexed by k % windowSize().
+//
+// cancel() can be called from any thread. It stops every search
+// running at the time (run() returns false); searches started
+// afterwards are not affected, so a cancelled caller never leaves
+// a later, unrelated search with no result.
+//////////////////////////////////////////////////////////////
+class ParallelSearch
+{
+
+public:
+	static unsigned int threads;          // 0 = std::thread::hardware_concurrency()
+	static const unsigned int WINDOW = 64; // candidates in flight per thread
+
+	static bool run(unsigned long long limit,
+		const std::function<bool(unsigned long long)>& test,
+		const std::function<bool(unsigned long long)>& accept);
+
+	static void cancel();
+
+	static unsigned int threadCount();
+	static unsigned long long windowSize();      // WINDOW * threadCount()
+
+private:
+	static std::atomic<unsigned long long> cancel_count;   // run() stops once it changes
+	static bool cancelled(unsigned long long count);
+};
+
+// Serial versus parallel prime and moduli searches (times and identical results)
+void parallel_search_benchmark();
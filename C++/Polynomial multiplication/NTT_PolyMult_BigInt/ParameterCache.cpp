@@ -0,0 +1,456 @@
+#include "ParameterCache.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include "RNS.h"
+#include "NTT.h"
+#include "general_functions.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+typedef unsigned long long u64;
+typedef unsigned int u32;
+
+bool   ParameterCache::enabled   = false;
+string ParameterCache::directory = "";
+
+static const char MAGIC[8] = { 'N', 'T', 'T', 'P', 'C', 'A', 'C', 'H' };
+static const u32 KIND_RNS = 1;
+static const u32 KIND_NTT = 2;
+static const size_t HEADER_SIZE = 8 + 4 + 4 + 8 + 8 + 8;
+
+//////////////////////////////////////////////////////////////
+// FNV-1a, for the key hash and the payload checksum
+//////////////////////////////////////////////////////////////
+static u64 fnv1a(const unsigned char* p, size_t n) {
+	u64 h = 14695981039346656037ULL;
+	for (size_t i = 0; i < n; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+//////////////////////////////////////////////////////////////
+// Serialization
+//////////////////////////////////////////////////////////////
+struct CacheWriter {
+	string buf;
+
+	void put32(u32 v) {
+		for (int i = 0; i < 4; i++)
+			buf.push_back(char(v >> (8 * i)));
+	}
+	void put64(u64 v) {
+		for (int i = 0; i < 8; i++)
+			buf.push_back(char(v >> (8 * i)));
+	}
+	// 64-bit words, least significant first
+	void putBig(const BigUnsigned& A) {
+		u32 n_words = (A.bitLength() + 63) / 64;
+		put32(n_words);
+		for (u32 w = 0; w < n_words; w++) {
+			u64 word = 0;
+			for (unsigned int bit = 0; bit < 64; bit += BigUnsigned::N) {
+				BigUnsigned::Index i = (w * 64 + bit) / BigUnsigned::N;
+				if (i < A.getLength())
+					word |= u64(A.getBlock(i)) << bit;
+			}
+			put64(word);
+		}
+	}
+	void putVector(const vector<BigUnsigned>& v) {
+		put32(u32(v.size()));
+		for (size_t i = 0; i < v.size(); i++)
+			putBig(v[i]);
+	}
+	void putMatrix(const vector<vector<BigUnsigned>>& m) {
+		put32(u32(m.size()));
+		for (size_t i = 0; i < m.size(); i++)
+			putVector(m[i]);
+	}
+};
+
+// Reads stop at the end of the data; ok turns false if one would overrun.
+struct CacheReader {
+	const unsigned char* p;
+	size_t size, pos;
+	bool ok;
+
+	CacheReader(const unsigned char* data, size_t n) : p(data), size(n), pos(0), ok(true) {}
+
+	bool has(size_t n) {
+		if (!ok || size - pos < n)
+			ok = false;
+		return ok;
+	}
+	u32 get32() {
+		u32 v = 0;
+		if (has(4)) {
+			for (int i = 0; i < 4; i++)
+				v |= u32(p[pos + i]) << (8 * i);
+			pos += 4;
+		}
+		return v;
+	}
+	u64 get64() {
+		u64 v = 0;
+		if (has(8)) {
+			for (int i = 0; i < 8; i++)
+				v |= u64(p[pos + i]) << (8 * i);
+			pos += 8;
+		}
+		return v;
+	}
+	BigUnsigned getBig() {
+		BigUnsigned A;
+		u32 n_words = get32();
+		if (!has(size_t(n_words) * 8))
+			return A;
+		// top block first so the number is only allocated once
+		for (long b = long(n_words) * 64 / BigUnsigned::N - 1; b >= 0; b--) {
+			size_t bit = size_t(b) * BigUnsigned::N;
+			const unsigned char* w = p + pos + (bit / 64) * 8;
+			u64 word = 0;
+			for (int i = 0; i < 8; i++)
+				word |= u64(w[i]) << (8 * i);
+			A.setBlock(b, BigUnsigned::Blk(word >> (bit % 64)));
+		}
+		pos += size_t(n_words) * 8;
+		return A;
+	}
+	// count must equal expected
+	vector<BigUnsigned> getVector(size_t expected) {
+		vector<BigUnsigned> v;
+		u32 count = get32();
+		if (count != expected) {
+			ok = false;
+			return v;
+		}
+		for (u32 i = 0; i < count && ok; i++)
+			v.push_back(getBig());
+		return v;
+	}
+	vector<vector<BigUnsigned>> getMatrix(size_t rows, size_t cols) {
+		vector<vector<BigUnsigned>> m;
+		u32 count = get32();
+		if (count != rows) {
+			ok = false;
+			return m;
+		}
+		for (u32 i = 0; i < count && ok; i++)
+			m.push_back(getVector(cols));
+		return m;
+	}
+};
+
+//////////////////////////////////////////////////////////////
+// Read-only memory mapping of a whole file
+//////////////////////////////////////////////////////////////
+class MappedFile {
+public:
+	const unsigned char* data = NULL;
+	size_t size = 0;
+
+	MappedFile(const string& path) {
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER len;
+		if (!GetFileSizeEx(file, &len) || len.QuadPart == 0)
+			return;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return;
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data != NULL)
+			size = size_t(len.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				data = static_cast<const unsigned char*>(p);
+				size = size_t(st.st_size);
+			}
+		}
+		close(fd);
+#endif
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data != NULL)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (data != NULL)
+			munmap(const_cast<unsigned char*>(data), size);
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+	MappedFile(const MappedFile&);
+	void operator=(const MappedFile&);
+};
+
+//////////////////////////////////////////////////////////////
+// Header checks
+// On success the reader is positioned after the stored key.
+//////////////////////////////////////////////////////////////
+static bool openPayload(const MappedFile& f, u32 kind, const string& key, CacheReader& payload) {
+	if (f.data == NULL || f.size < HEADER_SIZE || memcmp(f.data, MAGIC, 8) != 0)
+		return false;
+
+	CacheReader header(f.data + 8, HEADER_SIZE - 8);
+	u32 version   = header.get32();
+	u32 file_kind = header.get32();
+	u64 key_hash  = header.get64();
+	u64 size      = header.get64();
+	u64 checksum  = header.get64();
+
+	if (version != ParameterCache::VERSION || file_kind != kind)
+		return false;
+	if (key_hash != fnv1a((const unsigned char*)key.data(), key.size()))
+		return false;
+	if (size != f.size - HEADER_SIZE || size < key.size())
+		return false;
+
+	const unsigned char* p = f.data + HEADER_SIZE;
+	if (checksum != fnv1a(p, size_t(size)))
+		return false;
+	if (memcmp(p, key.data(), key.size()) != 0)        // hash collision
+		return false;
+
+	payload = CacheReader(p, size_t(size));
+	payload.pos = key.size();
+	return true;
+}
+
+static unsigned long processId() {
+#ifdef _WIN32
+	return GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+static void writeFile(const string& path, u32 kind, const string& key, const string& payload) {
+	CacheWriter header;
+	header.put32(ParameterCache::VERSION);
+	header.put32(kind);
+	header.put64(fnv1a((const unsigned char*)key.data(), key.size()));
+	header.put64(payload.size());
+	header.put64(fnv1a((const unsigned char*)payload.data(), payload.size()));
+
+	// write a temporary file and rename it, so a reader never sees half a file.
+	// The name is unique to the process and the call, so writers never share one.
+	static atomic<unsigned long> writes(0);
+	string tmp = path + "." + to_string(processId()) + "." + to_string(writes++) + ".tmp";
+	ofstream file(tmp, ios::binary | ios::trunc);
+	if (!file)
+		return;
+	file.write(MAGIC, 8);
+	file.write(header.buf.data(), header.buf.size());
+	file.write(payload.data(), payload.size());
+	file.close();
+	if (!file) {
+		remove(tmp.c_str());
+		return;
+	}
+	remove(path.c_str());
+	if (rename(tmp.c_str(), path.c_str()) != 0)
+		remove(tmp.c_str());
+}
+
+static string hexName(const string& prefix, const string& key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", fnv1a((const unsigned char*)key.data(), key.size()));
+	return ParameterCache::directory + prefix + name + ".cache";
+}
+
+//////////////////////////////////////////////////////////////
+// RNS: keyed by (bases, M), holds everything initializeParameters
+// derives after the Bajard condition check
+//////////////////////////////////////////////////////////////
+static string rnsKey(const RNS& rns) {
+	CacheWriter key;
+	key.putVector(rns.bases);
+	key.putBig(rns.M);
+	return key.buf;
+}
+
+string ParameterCache::filename(const RNS& rns) {
+	return hexName("rns_params_", rnsKey(rns));
+}
+
+bool ParameterCache::load(RNS& rns) {
+	if (!enabled)
+		return false;
+
+	string key = rnsKey(rns);
+	MappedFile f(filename(rns));
+	CacheReader r(NULL, 0);
+	if (!openPayload(f, KIND_RNS, key, r))
+		return false;
+
+	size_t n1 = rns.n_base1, n2 = rns.n_base2, n2r = rns.n_base2_with_mr;
+	vector<BigUnsigned> D1_i           = r.getVector(n1);
+	vector<BigUnsigned> D2_j           = r.getVector(n2);
+	BigUnsigned         D1_inv_red_r   = r.getBig();
+	BigUnsigned         two_inv_red_r  = r.getBig();
+	vector<BigUnsigned> M_inv_red_i    = r.getVector(n1);
+	vector<BigUnsigned> M_red_j        = r.getVector(n2r);
+	vector<BigUnsigned> D1_i_inv_red_i = r.getVector(n1);
+	vector<vector<BigUnsigned>> D1_i_red_j = r.getMatrix(n1, n2r);
+	vector<vector<BigUnsigned>> D2_j_red_i = r.getMatrix(n2, n1);
+	vector<BigUnsigned> D2_j_inv_red_j = r.getVector(n2);
+	vector<BigUnsigned> D2_j_red_r     = r.getVector(n2);
+	vector<BigUnsigned> D2_red_i       = r.getVector(n1);
+	vector<BigUnsigned> D1_inv_red_j   = r.getVector(n2r);
+	BigUnsigned         D2_inv_red_r   = r.getBig();
+	if (!r.ok || r.pos != r.size)
+		return false;
+
+	// consistency: D1_i * m_i = D1 and D1_i * D1_i^-1 = 1 mod m_i
+	for (size_t i = 0; i < n1; i++) {
+		if (D1_i[i] * rns.base1[i] != rns.D1 || (D1_i[i] * D1_i_inv_red_i[i]) % rns.base1[i] != 1)
+			return false;
+	}
+	for (size_t j = 0; j < n2; j++) {
+		if (D2_j[j] * rns.base2[j] != rns.D2)
+			return false;
+	}
+
+	rns.D1_i           = D1_i;
+	rns.D2_j           = D2_j;
+	rns.D1_inv_red_r   = D1_inv_red_r;
+	rns.two_inv_red_r  = two_inv_red_r;
+	rns.M_inv_red_i    = M_inv_red_i;
+	rns.M_red_j        = M_red_j;
+	rns.D1_i_inv_red_i = D1_i_inv_red_i;
+	rns.D1_i_red_j     = D1_i_red_j;
+	rns.D2_j_red_i     = D2_j_red_i;
+	rns.D2_j_inv_red_j = D2_j_inv_red_j;
+	rns.D2_j_red_r     = D2_j_red_r;
+	rns.D2_red_i       = D2_red_i;
+	rns.D1_inv_red_j   = D1_inv_red_j;
+	rns.D2_inv_red_r   = D2_inv_red_r;
+	return true;
+}
+
+void ParameterCache::save(const RNS& rns) {
+	if (!enabled)
+		return;
+
+	string key = rnsKey(rns);
+	CacheWriter w;
+	w.buf = key;
+	w.putVector(rns.D1_i);
+	w.putVector(rns.D2_j);
+	w.putBig(rns.D1_inv_red_r);
+	w.putBig(rns.two_inv_red_r);
+	w.putVector(rns.M_inv_red_i);
+	w.putVector(rns.M_red_j);
+	w.putVector(rns.D1_i_inv_red_i);
+	w.putMatrix(rns.D1_i_red_j);
+	w.putMatrix(rns.D2_j_red_i);
+	w.putVector(rns.D2_j_inv_red_j);
+	w.putVector(rns.D2_j_red_r);
+	w.putVector(rns.D2_red_i);
+	w.putVector(rns.D1_inv_red_j);
+	w.putBig(rns.D2_inv_red_r);
+
+	writeFile(filename(rns), KIND_RNS, key, w.buf);
+}
+
+//////////////////////////////////////////////////////////////
+// NTT: keyed by (n, minimum modulus, prime promise), holds the
+// solveParameters results and the phi table
+//////////////////////////////////////////////////////////////
+static string nttKey(const NTT& ntt, bool modulusIsPrimeIPromise) {
+	CacheWriter key;
+	key.putBig(ntt.vec_length);
+	key.putBig(ntt.min_mod);
+	key.put32(modulusIsPrimeIPromise ? 1 : 0);
+	return key.buf;
+}
+
+string ParameterCache::filename(const NTT& ntt, bool modulusIsPrimeIPromise) {
+	return hexName("ntt_params_", nttKey(ntt, modulusIsPrimeIPromise));
+}
+
+bool ParameterCache::load(NTT& ntt, bool modulusIsPrimeIPromise) {
+	if (!enabled)
+		return false;
+
+	string key = nttKey(ntt, modulusIsPrimeIPromise);
+	MappedFile f(filename(ntt, modulusIsPrimeIPromise));
+	CacheReader r(NULL, 0);
+	if (!openPayload(f, KIND_NTT, key, r))
+		return false;
+
+	BigUnsigned modulus = r.getBig();
+	BigUnsigned w_n     = r.getBig();
+	BigUnsigned w_n_inv = r.getBig();
+	BigUnsigned phi     = r.getBig();
+	BigUnsigned phi_inv = r.getBig();
+	vector<BigUnsigned> phi_table = r.getVector((ntt.vec_length / 2).toUnsignedLong());
+	if (!r.ok || r.pos != r.size)
+		return false;
+
+	// consistency: inverses, phi^2 = w_n, and the table starts 1, phi
+	if (modulus < 2 || (w_n * w_n_inv) % modulus != 1 || (phi * phi_inv) % modulus != 1 || (phi * phi) % modulus != w_n)
+		return false;
+	if (phi_table.size() > 1 && (phi_table[0] != 1 || phi_table[1] != phi))
+		return false;
+
+	ntt.modulus   = modulus;
+	ntt.w_n       = w_n;
+	ntt.w_n_inv   = w_n_inv;
+	ntt.phi       = phi;
+	ntt.phi_inv   = phi_inv;
+	ntt.phi_table = phi_table;
+	return true;
+}
+
+void ParameterCache::save(const NTT& ntt, bool modulusIsPrimeIPromise) {
+	if (!enabled)
+		return;
+
+	string key = nttKey(ntt, modulusIsPrimeIPromise);
+	CacheWriter w;
+	w.buf = key;
+	w.putBig(ntt.modulus);
+	w.putBig(ntt.w_n);
+	w.putBig(ntt.w_n_inv);
+	w.putBig(ntt.phi);
+	w.putBig(ntt.phi_inv);
+	w.putVector(ntt.phi_table);
+
+	writeFile(filename(ntt, modulusIsPrimeIPromise), KIND_NTT, key, w.buf);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+class RNS;
+class NTT;
+
+//////////////////////////////////////////////////////////////
+// On-disk cache of derived RNS and NTT parameters
+//
+// RNS::initializeParameters and the NTT constructor save what
+// they compute into a binary file keyed by their inputs
+// ((moduli, M) or (n, minimum modulus)), and later runs map the
+// file into memory instead of redoing the modinvs, products and
+// root searches.
+//
+// File layout (all integers little endian):
+//   magic "NTTPCACH", u32 version, u32 kind,
+//   u64 key hash, u64 payload size, u64 payload checksum,
+//   payload: the key itself, then the parameters.
+// BigUnsigned values are a u32 word count and 64-bit words.
+//
+// A file is used only if every header field, the stored key and
+// the checksum match, and the values pass a few consistency
+// checks. Anything else (old version, truncated or corrupted
+// file, hash collision) is ignored and the parameters are
+// recomputed and the file rewritten.
+//
+// Off by default: set enabled (and directory) to use it. Writers
+// go through a temporary file unique to the process and call, so
+// processes sharing a directory never write over each other.
+//////////////////////////////////////////////////////////////
+class ParameterCache
+{
+
+public:
+	static const unsigned int VERSION = 2;   // 2: RNS conversion weights no longer stored (built lazily)
+
+	static bool enabled;             // load and save at all, false by default
+	static std::string directory;    // prefix for cache files, "" = working directory
+
+	// Fill the derived parameters of an RNS/NTT whose key fields are
+	// already set. Return false (leaving it untouched) on a miss.
+	static bool load(RNS& rns);
+	static bool load(NTT& ntt, bool modulusIsPrimeIPromise);
+
+	static void save(const RNS& rns);
+	static void save(const NTT& ntt, bool modulusIsPrimeIPromise);
+
+	static std::string filename(const RNS& rns);
+	static std::string filename(const NTT& ntt, bool modulusIsPrimeIPromise);
+};
@@ -0,0 +1,353 @@
+#include "ParameterCatalog.h"
+#include <iostream>
+#include <sstream>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#include "general_functions.h"
+#include "primality.h"
+#include "RNS.h"
+#include "NTT.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////
+// The catalog
+//
+// Roots are the ones solveParameters finds (a^((q-1)/2n) for the
+// smallest working a), except Kyber's 17 and Dilithium's 1753,
+// which are the roots those standards use. RNS bases are the
+// first 2k + 1 32-bit primes = 1 mod 2n from
+// RNS::determineNTTprimes, with the smallest k whose base2
+// covers NTT::rnsRangeNeeded. That is far more than the Bajard
+// conditions ask for: the RNS NTT only reduces on its last stage.
+//////////////////////////////////////////////////////////////
+static const CatalogEntry catalog[] = {
+	{ "kyber", 128,
+	  "3329",
+	  "289", "2419",
+	  "17", "1175",
+	  "3303",
+	  "4294962689 4294961921 4294957057 4294955009 4294954753 4294953473 4294953217" },
+	{ "dilithium", 256,
+	  "8380417",
+	  "3073009", "6635910",
+	  "1753", "731434",
+	  "8347681",
+	  "4294962689 4294957057 4294955009 4294953473 4294947329 4294938113 4294937089 4294935553 "
+	  "4294935041 4294929409 4294924289 4294921217 4294914049 4294913537 4294903297" },
+	{ "falcon512", 512,
+	  "12289",
+	  "3400", "2859",
+	  "10302", "8974",
+	  "12265",
+	  "4294957057 4294955009 4294935553 4294929409 4294924289 4294921217 4294914049 4294895617 "
+	  "4294890497 4294884353 4294878209" },
+	{ "newhope1024", 1024,
+	  "12289",
+	  "10302", "8974",
+	  "1945", "4050",
+	  "12277",
+	  "4294957057 4294955009 4294924289 4294914049 4294895617 4294850561 4294828033 4294809601 "
+	  "4294807553 4294729729 4294709249" },
+	{ "ntt4096_q60", 4096,
+	  "1152921504606830593",
+	  "644283108363935541", "1045939966171253988",
+	  "431606828070683274", "164227591873870967",
+	  "1152640029630119941",
+	  "4294828033 4294729729 4294483969 4294475777 4294451201 4294008833 4293918721 4293844993 "
+	  "4293836801 4293550081 4293517313 4293500929 4293468161 4293230593 4293206017 4293181441 "
+	  "4293173249 4292984833 4292804609 4292780033 4292763649 4292755457 4292591617 4292558849 "
+	  "4292534273 4292485121 4292313089 4292272129 4292239361 4292149249 4292141057 4292124673 "
+	  "4292116481 4292026369 4292018177 4291952641 4291510273 4291338241 4291289089 4291117057 "
+	  "4290764801 4290691073 4290600961 4290297857 4290224129 4290076673 4290060289 4290035713 "
+	  "4289830913 4289667073 4289609729" },
+	{ "fhe8192_q0", 8192,
+	  "18014398508400641",
+	  "201240562879367", "11525105385325931",
+	  "9354911369072846", "14894152705101290",
+	  "18012199485145221",
+	  "4294475777 4293918721 4293836801 4293230593 4293181441 4292984833 4292804609 4292755457 "
+	  "4292591617 4292558849 4292313089 4292149249 4292116481 4292018177 4291952641 4291510273 "
+	  "4291117057 4290691073 4290297857 4290035713 4289609729 4289462273 4289150977 4288905217 "
+	  "4288806913 4288659457 4288626689 4288184321 4288086017 4287987713 4287823873 4287676417 "
+	  "4287479809 4287447041 4287397889 4286955521 4286709761 4286496769 4286464001 4286349313 "
+	  "4286251009 4286103553 4286054401 4285956097 4285808641 4285775873 4285677569 4285464577 "
+	  "4285382657" },
+	{ "fhe8192_q1", 8192,
+	  "18014398508138497",
+	  "16107046608253363", "651557753887503",
+	  "14423865892627390", "4147271125841961",
+	  "18012199484883109",
+	  "4294475777 4293918721 4293836801 4293230593 4293181441 4292984833 4292804609 4292755457 "
+	  "4292591617 4292558849 4292313089 4292149249 4292116481 4292018177 4291952641 4291510273 "
+	  "4291117057 4290691073 4290297857 4290035713 4289609729 4289462273 4289150977 4288905217 "
+	  "4288806913 4288659457 4288626689 4288184321 4288086017 4287987713 4287823873 4287676417 "
+	  "4287479809 4287447041 4287397889 4286955521 4286709761 4286496769 4286464001 4286349313 "
+	  "4286251009 4286103553 4286054401 4285956097 4285808641 4285775873 4285677569 4285464577 "
+	  "4285382657" },
+	{ "fhe8192_q2", 8192,
+	  "18014398507892737",
+	  "17715106133810479", "11919755826974252",
+	  "12617745759101472", "9009186839552171",
+	  "18012199484637379",
+	  "4294475777 4293918721 4293836801 4293230593 4293181441 4292984833 4292804609 4292755457 "
+	  "4292591617 4292558849 4292313089 4292149249 4292116481 4292018177 4291952641 4291510273 "
+	  "4291117057 4290691073 4290297857 4290035713 4289609729 4289462273 4289150977 4288905217 "
+	  "4288806913 4288659457 4288626689 4288184321 4288086017 4287987713 4287823873 4287676417 "
+	  "4287479809 4287447041 4287397889 4286955521 4286709761 4286496769 4286464001 4286349313 "
+	  "4286251009 4286103553 4286054401 4285956097 4285808641 4285775873 4285677569 4285464577 "
+	  "4285382657" },
+	{ "fhe8192_q3", 8192,
+	  "18014398507794433",
+	  "4851895262264017", "170776757611231",
+	  "9871473061968162", "15349652185455376",
+	  "18012199484539087",
+	  "4294475777 4293918721 4293836801 4293230593 4293181441 4292984833 4292804609 4292755457 "
+	  "4292591617 4292558849 4292313089 4292149249 4292116481 4292018177 4291952641 4291510273 "
+	  "4291117057 4290691073 4290297857 4290035713 4289609729 4289462273 4289150977 4288905217 "
+	  "4288806913 4288659457 4288626689 4288184321 4288086017 4287987713 4287823873 4287676417 "
+	  "4287479809 4287447041 4287397889 4286955521 4286709761 4286496769 4286464001 4286349313 "
+	  "4286251009 4286103553 4286054401 4285956097 4285808641 4285775873 4285677569 4285464577 "
+	  "4285382657" },
+	{ "fhe16384_q0", 16384,
+	  "18014398508400641",
+	  "9354911369072846", "14894152705101290",
+	  "3409294187645358", "16299751271747322",
+	  "18013298996772931",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q1", 16384,
+	  "18014398508138497",
+	  "14423865892627390", "4147271125841961",
+	  "10829602949590969", "565952903733338",
+	  "18013298996510803",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q2", 16384,
+	  "18014398507614209",
+	  "9476500011513354", "9931666014777011",
+	  "4232939102238000", "9413520577454203",
+	  "18013298995986547",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q3", 16384,
+	  "18014398507220993",
+	  "8464470983579311", "16825848487499160",
+	  "1297501185515392", "10739614024643313",
+	  "18013298995593355",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q4", 16384,
+	  "18014398506827777",
+	  "7769381878509905", "8598264687752387",
+	  "9939006393104001", "16012826246323324",
+	  "18013298995200163",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q5", 16384,
+	  "18014398506729473",
+	  "854801374128235", "5904231933147481",
+	  "3845957860237811", "6421291402121314",
+	  "18013298995101865",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q6", 16384,
+	  "18014398505943041",
+	  "2480646762427057", "3581039820214776",
+	  "9079520982591265", "14221761286701061",
+	  "18013298994315481",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+	{ "fhe16384_q7", 16384,
+	  "18014398504206337",
+	  "3865888231128755", "13195791260866972",
+	  "15873466546437701", "270264103703779",
+	  "18013298992578883",
+	  "4294475777 4293918721 4293230593 4292804609 4292313089 4292149249 4292116481 4292018177 "
+	  "4291952641 4289462273 4288905217 4288806913 4288184321 4288086017 4287987713 4287823873 "
+	  "4287397889 4286709761 4286349313 4286251009 4286054401 4285956097 4285464577 4284874753 "
+	  "4284776449 4284579841 4284088321 4283301889 4283269121 4282482689 4281204737 4281106433 "
+	  "4281008129 4280844289 4280320001 4280156161 4280025089 4279730177 4279468033 4279369729 "
+	  "4279074817 4279042049 4278386689 4278353921 4278255617 4277501953 4277403649 4277207041 "
+	  "4276092929 4275798017 4274749441 4274323457 4274126849" },
+};
+
+static const int n_entries = sizeof(catalog) / sizeof(catalog[0]);
+
+//////////////////////////////////////////////////////////////
+// Lookup
+//////////////////////////////////////////////////////////////
+const CatalogEntry* ParameterCatalog::find(string name) {
+	for (int i = 0; i < n_entries; i++) {
+		if (name == catalog[i].name)
+			return &catalog[i];
+	}
+	return NULL;
+}
+
+bool ParameterCatalog::lookup(string name, Parameters& out) {
+	const CatalogEntry* e = find(name);
+	if (e == NULL)
+		return false;
+
+	out.name    = e->name;
+	out.n       = e->n;
+	out.modulus = stringToBigUnsigned(e->modulus);
+	out.w_n     = stringToBigUnsigned(e->w_n);
+	out.w_n_inv = stringToBigUnsigned(e->w_n_inv);
+	out.phi     = stringToBigUnsigned(e->phi);
+	out.phi_inv = stringToBigUnsigned(e->phi_inv);
+	out.n_inv   = stringToBigUnsigned(e->n_inv);
+
+	out.rns_bases.clear();
+	istringstream bases(e->rns_bases);
+	string val;
+	while (bases >> val)
+		out.rns_bases.push_back(stringToBigUnsigned(val));
+	return true;
+}
+
+vector<string> ParameterCatalog::names() {
+	vector<string> list;
+	for (int i = 0; i < n_entries; i++)
+		list.push_back(catalog[i].name);
+	return list;
+}
+
+vector<string> ParameterCatalog::chain(string prefix) {
+	vector<string> list;
+	prefix += "_q";
+	for (int i = 0; i < n_entries; i++) {
+		if (string(catalog[i].name).compare(0, prefix.size(), prefix) == 0)
+			list.push_back(catalog[i].name);
+	}
+	return list;
+}
+
+//////////////////////////////////////////////////////////////
+// Checks one parameter set
+// q prime, 2n | q-1, phi a primitive 2nth root with phi^2 = w_n,
+// the inverses, and distinct prime RNS bases meeting the Bajard
+// conditions for q with a base2 wide enough for calculate_rns.
+//////////////////////////////////////////////////////////////
+bool ParameterCatalog::verify(const Parameters& p, bool print) {
+	const BigUnsigned& q = p.modulus;
+	vector<string> failed;
+
+	if (!isPrime(q))
+		failed.push_back("modulus not prime");
+	if (!((q - 1) % (p.n * 2)).isZero())
+		failed.push_back("2n does not divide q-1");
+	if (pow_mod(p.phi, p.n, q) != q - 1)
+		failed.push_back("phi not a primitive 2nth root");       // phi^n = -1 for n a power of two
+	if ((p.phi * p.phi) % q != p.w_n)
+		failed.push_back("phi^2 != w_n");
+	if ((p.w_n * p.w_n_inv) % q != 1)
+		failed.push_back("w_n_inv");
+	if ((p.phi * p.phi_inv) % q != 1)
+		failed.push_back("phi_inv");
+	if ((p.n * p.n_inv) % q != 1)
+		failed.push_back("n_inv");
+
+	for (size_t i = 0; i < p.rns_bases.size(); i++) {
+		if (!isPrime(p.rns_bases[i]))
+			failed.push_back("RNS base not prime");
+		for (size_t j = 0; j < i; j++) {
+			if (p.rns_bases[i] == p.rns_bases[j])
+				failed.push_back("repeated RNS base");
+		}
+	}
+	if (!RNS::checkBases(p.rns_bases, q))
+		failed.push_back("RNS bases do not meet the Bajard conditions");
+	else {
+		size_t k = (p.rns_bases.size() - 1) / 2;
+		if (!(NTT::rnsRangeNeeded(p.n, q) < product(vector<BigUnsigned>(p.rns_bases.begin() + k, p.rns_bases.begin() + 2 * k))))
+			failed.push_back("RNS base2 too small for the RNS NTT");
+	}
+
+	if (print) {
+		cout << p.name << " (n = " << p.n << ", q = " << q << "): ";
+		if (failed.empty())
+			cout << "ok" << endl;
+		for (size_t i = 0; i < failed.size(); i++)
+			cout << failed[i] << ((i + 1 < failed.size()) ? ", " : "\n");
+	}
+	return failed.empty();
+}
+
+//////////////////////////////////////////////////////////////
+// RNS round trip
+// One random polynomial through calculate_rns, compared after
+// reduction with calculate, and the reduced evaluation back
+// through the inverse.
+//////////////////////////////////////////////////////////////
+bool ParameterCatalog::rnsRoundTrip(const Parameters& p, bool print) {
+	NTT ntt = NTT::fromCatalog(p.name);
+	if (ntt.rns.bases.empty())
+		return false;
+
+	vector<BigUnsigned> A = sample_polynomial(p.n, p.modulus);
+	vector<BigUnsigned> E = ntt.rns.reverseConverter_polynomial(ntt.calculate_rns(ntt.rns.forwardConverter_polynomial(A, ntt.rns.bases)), ntt.rns.bases);
+	for (size_t i = 0; i < E.size(); i++)
+		E[i] %= p.modulus;
+	vector<BigUnsigned> Y = ntt.rns.reverseConverter_polynomial(ntt.calculate_rns(ntt.rns.forwardConverter_polynomial(E, ntt.rns.bases), true), ntt.rns.bases);
+	for (size_t i = 0; i < Y.size(); i++)
+		Y[i] %= p.modulus;
+
+	bool forward = vectorsAreEqual(E, ntt.calculate(A));
+	bool inverse = vectorsAreEqual(Y, A);
+	if (print) {
+		cout << p.name << " RNS NTT: " << (forward ? "forward ok" : "forward incorrect") << ", ";
+		cout << (inverse ? "inverse ok" : "inverse incorrect") << endl;
+	}
+	return forward && inverse;
+}
+
+//////////////////////////////////////////////////////////////
+// Verifies every entry
+//////////////////////////////////////////////////////////////
+void ParameterCatalog::selfTest(bool rns_round_trip) {
+	int n_correct = 0;
+
+	cout << endl << endl << "Parameter catalog test: " << endl;
+	for (int i = 0; i < n_entries; i++) {
+		Parameters p;
+		if (lookup(catalog[i].name, p) && verify(p, true) && (!rns_round_trip || rnsRoundTrip(p, true)))
+			n_correct++;
+	}
+	cout << endl << n_correct << "/" << n_entries << " tests correct." << endl;
+}
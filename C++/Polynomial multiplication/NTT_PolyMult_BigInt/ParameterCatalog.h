@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Catalog of precomputed NTT parameter sets
+//
+// Standard (n, q) pairs with their roots, inverses and an RNS
+// base (base1 | base2 | m_r) meeting the Bajard conditions for
+// q and wide enough for NTT::calculate_rns, so NTT::fromCatalog
+// can skip solveParameters. Values are decimal strings,
+// converted on lookup.
+//
+// phi is a primitive 2nth root of unity and w_n = phi^2. Kyber
+// uses n = 128: 3329 - 1 has no factor 512, so a 256-point
+// negacyclic NTT mod 3329 does not exist (Kyber multiplies in
+// degree 2 pieces over a 128-point one). FHE chains are listed
+// one prime per entry ("fhe8192_q0", "fhe8192_q1", ...).
+//////////////////////////////////////////////////////////////
+struct CatalogEntry {
+	const char* name;
+	unsigned int n;
+	const char* modulus;
+	const char* w_n;
+	const char* w_n_inv;
+	const char* phi;
+	const char* phi_inv;
+	const char* n_inv;
+	const char* rns_bases;      // space separated
+};
+
+class ParameterCatalog
+{
+
+public:
+	struct Parameters {
+		std::string name;
+		BigUnsigned n, modulus, w_n, w_n_inv, phi, phi_inv, n_inv;
+		std::vector<BigUnsigned> rns_bases;
+	};
+
+	static const CatalogEntry* find(std::string name);
+	static bool lookup(std::string name, Parameters& out);
+	static std::vector<std::string> names();
+	// entries of a multi-prime chain, e.g. "fhe8192" -> fhe8192_q0, fhe8192_q1, ...
+	static std::vector<std::string> chain(std::string prefix);
+
+	static bool verify(const Parameters& p, bool print = false);
+	// calculate_rns against calculate, and its inverse back to the input
+	static bool rnsRoundTrip(const Parameters& p, bool print = false);
+	// the round trip takes minutes for the n >= 4096 sets
+	static void selfTest(bool rns_round_trip = true);
+};
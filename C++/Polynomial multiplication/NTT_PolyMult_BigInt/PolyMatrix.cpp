@@ -0,0 +1,171 @@
+#include "PolyMatrix.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "general_functions.h"
+
+using namespace std;
+
+unsigned int PolyMatrix::threads = 0;
+
+//////////////////////////////////////////////////////////////
+// Threads
+//////////////////////////////////////////////////////////////
+unsigned int PolyMatrix::threadCount() {
+	unsigned int n = (threads != 0) ? threads : thread::hardware_concurrency();
+	return (n != 0) ? n : 1;
+}
+
+// Indices are handed out one at a time, so uneven rows balance
+void PolyMatrix::parallelFor(int count, const function<void(int)>& body) {
+	int n_threads = threadCount();
+	if (n_threads > count)
+		n_threads = count;
+
+	if (n_threads <= 1) {
+		for (int i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++)
+			body(i);
+	};
+
+	vector<thread> workers;
+	for (int t = 1; t < n_threads; t++)
+		workers.push_back(thread(worker));
+	worker();
+	for (int t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+//////////////////////////////////////////////////////////////
+// PolyVector
+//////////////////////////////////////////////////////////////
+PolyVector::PolyVector(int length, NTT& ntt, Polynomial::Ring ring) {
+	entries.assign(length, Polynomial(ntt, ring));
+}
+
+void PolyVector::toEvaluation() const {
+	PolyMatrix::parallelFor(entries.size(), [&](int i) { entries[i].evaluation(); });
+}
+
+void PolyVector::toCoefficients() const {
+	PolyMatrix::parallelFor(entries.size(), [&](int i) { entries[i].coefficients(); });
+}
+
+bool PolyVector::operator==(const PolyVector& B) const {
+	if (entries.size() != B.entries.size())
+		return false;
+	for (int i = 0; i < entries.size(); i++) {
+		if (!(entries[i] == B.entries[i]))
+			return false;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////
+// PolyMatrix
+//////////////////////////////////////////////////////////////
+PolyMatrix::PolyMatrix(int rows, int cols, NTT& ntt, Polynomial::Ring ring) : n_rows(rows), n_cols(cols) {
+	entries.assign(rows, vector<Polynomial>(cols, Polynomial(ntt, ring)));
+}
+
+void PolyMatrix::set(int row, int col, const Polynomial& entry) {
+	entries[row][col] = entry;
+	entries[row][col].evaluation();
+}
+
+PolyVector PolyMatrix::multiply(const PolyVector& v) const {
+	if (v.size() != n_cols) {
+		cout << "ERROR: " << n_rows << " x " << n_cols << " matrix times a vector of length " << v.size() << "." << endl;
+		return PolyVector();
+	}
+
+	// l forward NTTs (none for entries already transformed), then the rows
+	v.toEvaluation();
+
+	PolyVector result;
+	result.entries.resize(n_rows);
+	parallelFor(n_rows, [&](int i) { result.entries[i] = Polynomial::innerProduct(entries[i], v.entries); });
+	return result;
+}
+
+//////////////////////////////////////////////////////////////
+// Throughput of k x k times k, against a polynomial_multiply
+// (three transforms and a hadamard_product) per entry
+//////////////////////////////////////////////////////////////
+static void benchmark_rank(NTT& ntt, int k, int n_runs) {
+	typedef chrono::duration<double, milli> ms;
+	BigUnsigned q = ntt.modulus;
+
+	vector<vector<vector<BigUnsigned>>> a(k, vector<vector<BigUnsigned>>(k));
+	PolyMatrix A(k, k, ntt);
+	auto t0 = chrono::steady_clock::now();
+	for (int i = 0; i < k; i++) {
+		for (int j = 0; j < k; j++) {
+			a[i][j] = sample_polynomial(ntt.vec_length, q);
+			A.set(i, j, Polynomial(a[i][j], ntt));
+		}
+	}
+	auto t1 = chrono::steady_clock::now();
+
+	double t_engine = 0, t_entries = 0;
+	unsigned long transforms = 0;
+	bool same = true;
+	for (int r = 0; r < n_runs; r++) {
+		vector<vector<BigUnsigned>> s(k);
+		PolyVector S;
+		for (int j = 0; j < k; j++) {
+			s[j] = sample_polynomial(ntt.vec_length, q);
+			S.entries.push_back(Polynomial(s[j], ntt));
+		}
+
+		unsigned long f0 = Polynomial::forward_transforms, i0 = Polynomial::inverse_transforms;
+		auto t2 = chrono::steady_clock::now();
+		PolyVector T = A * S;
+		T.toCoefficients();
+		auto t3 = chrono::steady_clock::now();
+		transforms += (Polynomial::forward_transforms - f0) + (Polynomial::inverse_transforms - i0);
+
+		// one multiplication per entry, every operand transformed each time
+		PolyVector U(k, ntt);
+		for (int i = 0; i < k; i++) {
+			for (int j = 0; j < k; j++) {
+				Polynomial P = Polynomial(a[i][j], ntt) * Polynomial(s[j], ntt);
+				P.coefficients();
+				U[i] = U[i] + P;
+			}
+		}
+		auto t4 = chrono::steady_clock::now();
+
+		t_engine  += ms(t3 - t2).count();
+		t_entries += ms(t4 - t3).count();
+		same = same && (T == U);
+	}
+	t_engine  /= n_runs;
+	t_entries /= n_runs;
+
+	cout << k << " x " << k << ": " << t_engine << " ms per product (" << 1000 / t_engine << " per second, "
+		<< transforms / n_runs << " transforms), per entry: " << t_entries << " ms (" << 3 * k * k << " transforms), "
+		<< t_entries / t_engine << "x, " << (same ? "identical" : "DIFFERENT") << " results. Matrix set up once: "
+		<< ms(t1 - t0).count() << " ms." << endl;
+}
+
+void poly_matrix_benchmark(int n_runs) {
+	cout << endl << endl << "PolyMatrix benchmark (" << PolyMatrix::threadCount() << " threads, " << n_runs << " products each):" << endl;
+
+	const char* sets[2] = { "dilithium", "falcon512" };    // n = 256 and n = 512
+	for (int s = 0; s < 2; s++) {
+		NTT ntt = NTT::fromCatalog(sets[s]);
+		cout << endl << sets[s] << " (n = " << ntt.vec_length << ", q = " << ntt.modulus << "):" << endl;
+		for (int k = 2; k <= 4; k++)
+			benchmark_rank(ntt, k, n_runs);
+	}
+	cout << endl;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "Polynomial.h"
+
+//////////////////////////////////////////////////////////////
+// Module-lattice matrices and vectors of polynomials
+//
+// A PolyMatrix keeps every entry in evaluation (NTT) form from
+// the moment it is set, since a matrix such as the public A of
+// Module-LWE is reused for many products. multiply(v) brings
+// each entry of v to evaluation form once (l forward NTTs) and
+// computes each row as one fused Polynomial::innerProduct. The
+// result is left in evaluation form, so a k x l product costs
+// l + k transforms in all instead of 3*k*l for a
+// polynomial_multiply per entry.
+//
+// Transforms of vector entries and rows run on threadCount()
+// threads. NTT::calculate only reads the NTT, so one NTT can be
+// shared; all entries must use the same NTT and ring.
+//////////////////////////////////////////////////////////////
+class PolyVector
+{
+
+public:
+	std::vector<Polynomial> entries;
+
+	PolyVector() {}
+	PolyVector(int length, NTT& ntt, Polynomial::Ring ring = Polynomial::NEGACYCLIC);   // zero vector
+	PolyVector(std::vector<Polynomial> entries) : entries(entries) {}
+
+	int size() const { return entries.size(); }
+	Polynomial&       operator[](int i)       { return entries[i]; }
+	const Polynomial& operator[](int i) const { return entries[i]; }
+
+	void toEvaluation() const;      // forward NTT of every entry not yet transformed
+	void toCoefficients() const;    // inverse NTT of every entry held in evaluation form only
+	bool operator==(const PolyVector& B) const;
+};
+
+class PolyMatrix
+{
+
+public:
+	static unsigned int threads;    // 0 = std::thread::hardware_concurrency()
+
+	PolyMatrix() : n_rows(0), n_cols(0) {}
+	PolyMatrix(int rows, int cols, NTT& ntt, Polynomial::Ring ring = Polynomial::NEGACYCLIC);   // zero matrix
+
+	int rows() const { return n_rows; }
+	int cols() const { return n_cols; }
+	const Polynomial& at(int row, int col) const { return entries[row][col]; }
+	void set(int row, int col, const Polynomial& entry);   // transformed here, once
+
+	PolyVector multiply(const PolyVector& v) const;        // result in evaluation form
+	PolyVector operator*(const PolyVector& v) const { return multiply(v); }
+
+	static unsigned int threadCount();
+	static void parallelFor(int count, const std::function<void(int)>& body);   // body(0) ... body(count - 1)
+
+private:
+	int n_rows, n_cols;
+	std::vector<std::vector<Polynomial>> entries;   // entries[row][col]
+};
+
+// Matrix-vector products per second for module ranks 2, 3 and 4
+void poly_matrix_benchmark(int n_runs = 5);
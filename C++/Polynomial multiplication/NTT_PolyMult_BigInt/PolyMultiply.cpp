@@ -0,0 +1,898 @@
+#include "PolyMultiply.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "Polynomial.h"
+#include "MultiPrimeNTT.h"
+#include "primality.h"
+#include "general_functions.h"
+
+using namespace std;
+
+typedef vector<BigInteger> IntPoly;
+typedef unsigned long long word;
+
+map<pair<int, bool>, PolyMultiplier::Calibration> PolyMultiplier::calibrations;
+map<string, NTT> PolyMultiplier::ntts;
+mutex PolyMultiplier::lock;
+map<pair<int, bool>, mutex> PolyMultiplier::calibration_locks;
+map<string, mutex> PolyMultiplier::ntt_locks;
+
+//////////////////////////////////////////////////////////////
+// Integer products of equal length coefficient vectors
+//////////////////////////////////////////////////////////////
+static IntPoly schoolbook(const IntPoly& A, const IntPoly& B) {
+	if (A.empty() || B.empty())
+		return IntPoly();
+
+	IntPoly C(A.size() + B.size() - 1);
+	for (int i = 0; i < A.size(); i++) {
+		if (A[i].isZero())
+			continue;
+		for (int j = 0; j < B.size(); j++)
+			C[i + j] += A[i] * B[j];
+	}
+	return C;
+}
+
+static IntPoly part(const IntPoly& A, int start, int length) {
+	IntPoly P(length);
+	for (int i = 0; i < length && start + i < A.size(); i++)
+		P[i] = A[start + i];
+	return P;
+}
+
+static void add_at(IntPoly& C, const IntPoly& P, int offset) {
+	for (int i = 0; i < P.size() && offset + i < C.size(); i++)
+		C[offset + i] += P[i];
+}
+
+// (A0 + A1 x^h)(B0 + B1 x^h) from A0*B0, A1*B1 and (A0 + A1)(B0 + B1)
+static IntPoly karatsuba(const IntPoly& A, const IntPoly& B) {
+	int n = A.size();
+	if (n <= PolyMultiplier::RECURSION_LIMIT)
+		return schoolbook(A, B);
+
+	int h  = n / 2;
+	int hi = n - h;
+	IntPoly A0 = part(A, 0, h), A1 = part(A, h, hi);
+	IntPoly B0 = part(B, 0, h), B1 = part(B, h, hi);
+	A0.resize(hi);     // low halves padded to the length of the high ones
+	B0.resize(hi);
+
+	IntPoly Z0 = karatsuba(A0, B0);
+	IntPoly Z2 = karatsuba(A1, B1);
+	for (int i = 0; i < hi; i++) {
+		A0[i] += A1[i];
+		B0[i] += B1[i];
+	}
+	IntPoly Z1 = karatsuba(A0, B0);
+	for (int i = 0; i < Z1.size(); i++)
+		Z1[i] -= Z0[i] + Z2[i];
+
+	IntPoly C(2 * n - 1);
+	add_at(C, Z0, 0);
+	add_at(C, Z1, h);
+	add_at(C, Z2, 2 * h);
+	return C;
+}
+
+//////////////////////////////////////////////////////////////
+// Toom-k
+//
+// The parts are evaluated at 0, 1, -1, 2, -2, ... (2k - 2 finite
+// points) and infinity, multiplied recursively, and the product
+// coefficients interpolated as c = V^-1 v. V^-1 has rational
+// entries; it is kept as an integer matrix W and a common
+// denominator D, and the divisions by D are exact.
+//////////////////////////////////////////////////////////////
+struct ToomMatrix {
+	vector<long long> points;           // finite evaluation points
+	vector<vector<long long>> W;        // D * V^-1
+	long long D;
+};
+
+static long long gcd_ll(long long a, long long b) {
+	if (a < 0) a = -a;
+	if (b < 0) b = -b;
+	while (b != 0) {
+		long long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Gauss-Jordan on fractions num/den, small enough for long long at k <= 4
+static ToomMatrix toom_matrix(int k) {
+	ToomMatrix T;
+	int size = 2 * k - 1;
+	for (int p = 0; (int)T.points.size() < size - 1; p++) {
+		T.points.push_back(p == 0 ? 0 : ((p % 2) ? (p + 1) / 2 : -(p / 2)));
+	}
+
+	vector<vector<long long>> num(size, vector<long long>(2 * size, 0)), den(size, vector<long long>(2 * size, 1));
+	for (int r = 0; r < size; r++) {
+		long long power = 1;
+		for (int c = 0; c < size; c++) {
+			if (r < size - 1)
+				num[r][c] = power;
+			else
+				num[r][c] = (c == size - 1) ? 1 : 0;      // infinity: leading coefficient
+			if (r < size - 1)
+				power *= T.points[r];
+		}
+		num[r][size + r] = 1;
+	}
+
+	auto normalize = [&](int r, int c) {
+		long long g = gcd_ll(num[r][c], den[r][c]);
+		if (g > 1) { num[r][c] /= g; den[r][c] /= g; }
+		if (den[r][c] < 0) { num[r][c] = -num[r][c]; den[r][c] = -den[r][c]; }
+	};
+
+	for (int col = 0; col < size; col++) {
+		int pivot = col;
+		while (num[pivot][col] == 0)
+			pivot++;
+		swap(num[pivot], num[col]);
+		swap(den[pivot], den[col]);
+
+		long long pn = num[col][col], pd = den[col][col];
+		for (int c = 0; c < 2 * size; c++) {       // row /= pivot
+			num[col][c] *= pd;
+			den[col][c] *= pn;
+			normalize(col, c);
+		}
+		for (int r = 0; r < size; r++) {
+			if (r == col || num[r][col] == 0)
+				continue;
+			long long fn = num[r][col], fd = den[r][col];
+			for (int c = 0; c < 2 * size; c++) {   // row r -= f * row col
+				long long n2 = fn * num[col][c], d2 = fd * den[col][c];
+				num[r][c] = num[r][c] * d2 - n2 * den[r][c];
+				den[r][c] = den[r][c] * d2;
+				normalize(r, c);
+			}
+		}
+	}
+
+	T.D = 1;
+	for (int r = 0; r < size; r++)
+		for (int c = 0; c < size; c++)
+			T.D = T.D / gcd_ll(T.D, den[r][size + c]) * den[r][size + c];
+	T.W.assign(size, vector<long long>(size));
+	for (int r = 0; r < size; r++)
+		for (int c = 0; c < size; c++)
+			T.W[r][c] = num[r][size + c] * (T.D / den[r][size + c]);
+	return T;
+}
+
+static const ToomMatrix& toom_matrix_cached(int k) {
+	static const ToomMatrix toom3 = toom_matrix(3);
+	static const ToomMatrix toom4 = toom_matrix(4);
+	return (k == 3) ? toom3 : toom4;
+}
+
+static IntPoly toom(const IntPoly& A, const IntPoly& B, int k) {
+	int n = A.size();
+	if (n <= k * PolyMultiplier::RECURSION_LIMIT)
+		return karatsuba(A, B);
+
+	const ToomMatrix& T = toom_matrix_cached(k);
+	int m    = (n + k - 1) / k;
+	int size = 2 * k - 1;
+
+	vector<IntPoly> parts_a(k), parts_b(k);
+	for (int t = 0; t < k; t++) {
+		parts_a[t] = part(A, t * m, m);
+		parts_b[t] = part(B, t * m, m);
+	}
+
+	// evaluate (Horner, per coefficient) and multiply
+	vector<IntPoly> products(size);
+	for (int p = 0; p < size; p++) {
+		IntPoly ea, eb;
+		if (p == size - 1) {
+			ea = parts_a[k - 1];
+			eb = parts_b[k - 1];
+		}
+		else {
+			BigInteger x = BigInteger((long)T.points[p]);
+			ea = parts_a[k - 1];
+			eb = parts_b[k - 1];
+			for (int t = k - 2; t >= 0; t--) {
+				for (int i = 0; i < m; i++) {
+					ea[i] = ea[i] * x + parts_a[t][i];
+					eb[i] = eb[i] * x + parts_b[t][i];
+				}
+			}
+		}
+		products[p] = toom(ea, eb, k);
+	}
+
+	// interpolate
+	IntPoly C(2 * k * m - 1);
+	BigInteger D = BigInteger((long)T.D);
+	for (int j = 0; j < size; j++) {
+		IntPoly c(2 * m - 1);
+		for (int p = 0; p < size; p++) {
+			if (T.W[j][p] == 0)
+				continue;
+			BigInteger w = BigInteger((long)T.W[j][p]);
+			for (int i = 0; i < c.size(); i++)
+				c[i] += w * products[p][i];
+		}
+		for (int i = 0; i < c.size(); i++)
+			c[i] = c[i] / D;
+		add_at(C, c, j * m);
+	}
+	C.resize(2 * n - 1);
+	return C;
+}
+
+static IntPoly multiply_integer(const IntPoly& A, const IntPoly& B, PolyMultAlgorithm algorithm) {
+	switch (algorithm) {
+		case POLYMULT_KARATSUBA: return karatsuba(A, B);
+		case POLYMULT_TOOM3:     return toom(A, B, 3);
+		case POLYMULT_TOOM4:     return toom(A, B, 4);
+		default:                 return schoolbook(A, B);
+	}
+}
+
+static IntPoly to_integer(const vector<BigUnsigned>& A, int length) {
+	IntPoly P(length);
+	for (int i = 0; i < A.size(); i++)
+		P[i] = BigInteger(A[i]);
+	return P;
+}
+
+// x mod q in [0, q) for signed x
+static BigUnsigned reduce(const BigInteger& x, const BigUnsigned& q) {
+	BigUnsigned r = x.getMagnitude() % q;
+	if (x.getSign() == BigInteger::negative && !r.isZero())
+		r = q - r;
+	return r;
+}
+
+//////////////////////////////////////////////////////////////
+// Multiplication in Z_q[x]/(x^n -/+ 1)
+//////////////////////////////////////////////////////////////
+vector<BigUnsigned> PolyMultiplier::multiply(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, BigUnsigned modulus, bool negacyclic, PolyMultAlgorithm algorithm) {
+	int n = A.size();
+	if (B.size() != n || n == 0) {
+		cout << "ERROR: PolyMultiplier::multiply needs two polynomials of the same (nonzero) length." << endl;
+		return vector<BigUnsigned>();
+	}
+
+	// a ternary operand light enough (any ternary one if asked for)
+	if (algorithm == POLYMULT_AUTO || algorithm == POLYMULT_SPARSE) {
+		int max_weight = (algorithm == POLYMULT_SPARSE) ? n : sparseThreshold(n, modulus);
+		SparseTernary S;
+		if (SparseTernary::fromDense(A, modulus, S, max_weight))
+			return sparseMultiply(S, B, modulus, negacyclic);
+		if (SparseTernary::fromDense(B, modulus, S, max_weight))
+			return sparseMultiply(S, A, modulus, negacyclic);
+		if (algorithm == POLYMULT_SPARSE) {
+			cout << "ERROR: sparse multiplication needs a ternary operand." << endl;
+			return vector<BigUnsigned>();
+		}
+	}
+
+	if (algorithm == POLYMULT_AUTO)
+		algorithm = choose(n, modulus, negacyclic);
+
+	if (algorithm == POLYMULT_NTT) {
+		if (!nttFriendly(n, modulus)) {
+			cout << "ERROR: no NTT of length " << n << " modulo " << modulus << " (needs a prime with 2n | q - 1)." << endl;
+			return vector<BigUnsigned>();
+		}
+		NTT& ntt = cachedNTT(n, modulus);
+		Polynomial::Ring ring = negacyclic ? Polynomial::NEGACYCLIC : Polynomial::CYCLIC;
+		return (Polynomial(A, ntt, ring) * Polynomial(B, ntt, ring)).coefficients();
+	}
+
+	// integer product, folded at x^n = -/+1, reduced once
+	IntPoly C = multiply_integer(to_integer(A, n), to_integer(B, n), algorithm);
+	vector<BigUnsigned> R(n);
+	for (int i = 0; i < n; i++) {
+		BigInteger c = C[i];
+		if (i + n < C.size()) {
+			if (negacyclic)
+				c -= C[i + n];
+			else
+				c += C[i + n];
+		}
+		R[i] = reduce(c, modulus);
+	}
+	return R;
+}
+
+vector<BigUnsigned> PolyMultiplier::linearProduct(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, PolyMultAlgorithm algorithm) {
+	if (A.empty() || B.empty())
+		return vector<BigUnsigned>();
+
+	if (algorithm == POLYMULT_NTT || algorithm == POLYMULT_SPARSE || algorithm == POLYMULT_AUTO)
+		algorithm = POLYMULT_KARATSUBA;
+
+	int length = (A.size() > B.size()) ? A.size() : B.size();
+	IntPoly C = multiply_integer(to_integer(A, length), to_integer(B, length), algorithm);
+	C.resize(A.size() + B.size() - 1);
+
+	vector<BigUnsigned> R(C.size());
+	for (int i = 0; i < C.size(); i++)
+		R[i] = C[i].getMagnitude();
+	return R;
+}
+
+//////////////////////////////////////////////////////////////
+// Sparse ternary operands
+//////////////////////////////////////////////////////////////
+bool SparseTernary::fromDense(const vector<BigUnsigned>& A, BigUnsigned modulus, SparseTernary& S, int max_weight) {
+	SparseTernary T;
+	T.n = A.size();
+	BigUnsigned minus_one = modulus - 1;
+	for (int i = 0; i < A.size(); i++) {
+		if (A[i].isZero())
+			continue;
+		if (A[i] == 1)
+			T.plus.push_back(i);
+		else if (A[i] == minus_one)
+			T.minus.push_back(i);
+		else
+			return false;
+		if (T.weight() > max_weight)
+			return false;
+	}
+	S = T;
+	return true;
+}
+
+vector<BigUnsigned> SparseTernary::toDense(BigUnsigned modulus) const {
+	vector<BigUnsigned> A(n, BigUnsigned(0));
+	for (int t = 0; t < plus.size(); t++)
+		A[plus[t]] = 1;
+	for (int t = 0; t < minus.size(); t++)
+		A[minus[t]] = modulus - 1;
+	return A;
+}
+
+SparseTernary SparseTernary::sample(int n, int weight) {
+	vector<int> positions(n);
+	for (int i = 0; i < n; i++)
+		positions[i] = i;
+
+	SparseTernary S;
+	S.n = n;
+	for (int t = 0; t < weight && t < n; t++) {
+		swap(positions[t], positions[t + rand() % (n - t)]);
+		if (rand() % 2 == 0)
+			S.plus.push_back(positions[t]);
+		else
+			S.minus.push_back(positions[t]);
+	}
+	return S;
+}
+
+// c[j] += x[j] for j < length, reduced unless LAZY
+template<typename T, bool LAZY>
+static void add_run(T* c, const T* x, int length, const T& q) {
+	for (int j = 0; j < length; j++) {
+		T s = c[j] + x[j];
+		c[j] = (LAZY || s < q) ? s : s - q;
+	}
+}
+
+// Each nonzero x^i adds (+1) or subtracts (-1, a_neg = -a) a, shifted
+// by i: a[j] lands at i + j, the last i coefficients wrap to the front
+// (negated in x^n + 1, so taken from the other vector)
+template<typename T, bool LAZY>
+static vector<T> sparse_product(const SparseTernary& S, const vector<T>& a, const vector<T>& a_neg, bool negacyclic, const T& q) {
+	int n = a.size();
+	vector<T> c(n, T(0));
+	for (int sign = 0; sign < 2; sign++) {
+		const vector<int>& indices = (sign == 0) ? S.plus : S.minus;
+		const T* x      = (sign == 0) ? a.data() : a_neg.data();
+		const T* x_wrap = ((sign == 0) == negacyclic) ? a_neg.data() : a.data();
+		for (int t = 0; t < indices.size(); t++) {
+			int i = indices[t];
+			add_run<T, LAZY>(c.data() + i, x, n - i, q);
+			add_run<T, LAZY>(c.data(), x_wrap + (n - i), i, q);
+		}
+	}
+	return c;
+}
+
+vector<BigUnsigned> PolyMultiplier::sparseMultiply(const SparseTernary& S, const vector<BigUnsigned>& A, BigUnsigned modulus, bool negacyclic) {
+	int n = A.size();
+	if (S.n != n || n == 0) {
+		cout << "ERROR: sparse product of lengths " << S.n << " and " << n << "." << endl;
+		return vector<BigUnsigned>();
+	}
+
+	vector<BigUnsigned> C(n);
+	if (modulus.bitLength() < 64) {
+		word q = to_u64(modulus);
+		vector<word> a(n), a_neg(n), c;
+		for (int i = 0; i < n; i++) {
+			a[i]     = to_u64(A[i] % modulus);
+			a_neg[i] = (a[i] == 0) ? 0 : q - a[i];
+		}
+
+		// weight terms below q each: reduce once at the end if their sum fits
+		if (S.weight() == 0 || q - 1 <= ~word(0) / S.weight()) {
+			c = sparse_product<word, true>(S, a, a_neg, negacyclic, q);
+			for (int i = 0; i < n; i++)
+				c[i] %= q;
+		}
+		else
+			c = sparse_product<word, false>(S, a, a_neg, negacyclic, q);
+
+		for (int i = 0; i < n; i++)
+			C[i] = from_u64(c[i]);
+	}
+	else {
+		vector<BigUnsigned> a(n), a_neg(n);
+		for (int i = 0; i < n; i++) {
+			a[i]     = A[i] % modulus;
+			a_neg[i] = a[i].isZero() ? BigUnsigned(0) : modulus - a[i];
+		}
+		C = sparse_product<BigUnsigned, false>(S, a, a_neg, negacyclic, modulus);
+	}
+	return C;
+}
+
+// Measured (x86-64, 1 thread, sparse_multiply_benchmark): below 2^63
+// even a dense ternary operand (h = n) beats the NTT, 1.3 ms against
+// 16 ms at n = 1024. Wider moduli add in BigUnsigned, about 70 ns per
+// coefficient, against a CIOS NTT: the crossover was h = 60 - 80 for
+// 100 bits and 80 - 100 for 256 bits at n = 256 and 1024, close to
+// 3 log2(n) per 64-bit word of q.
+int PolyMultiplier::sparseThreshold(int n, BigUnsigned modulus) {
+	if (modulus.bitLength() < 64)
+		return n;
+
+	int log_n = 0;
+	while ((1 << log_n) < n)
+		log_n++;
+	return 3 * log_n * ((modulus.bitLength() + 63) / 64);
+}
+
+//////////////////////////////////////////////////////////////
+// Newton inversion mod x^k
+//
+// With f g = 1 mod x^m, f g = 1 + x^m h mod x^2m, and
+// g - x^m (g h) is the inverse mod x^2m. So each step needs the
+// top half h of f g and one product g h of half the length;
+// the low half of g does not change.
+//////////////////////////////////////////////////////////////
+static vector<BigUnsigned> truncated_product(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, int length, const BigUnsigned& q) {
+	vector<BigUnsigned> C = MultiPrimeNTT::exactProduct(A, B);
+	C.resize(length);
+	for (int i = 0; i < length; i++)
+		C[i] %= q;
+	return C;
+}
+
+vector<BigUnsigned> PolyMultiplier::seriesInverse(const vector<BigUnsigned>& f, int k, BigUnsigned modulus) {
+	if (f.empty() || k < 1 || !areCoprimes(f[0] % modulus, modulus)) {
+		cout << "ERROR: no inverse mod x^" << k << " (the constant coefficient must be a unit mod " << modulus << ")." << endl;
+		return vector<BigUnsigned>();
+	}
+
+	vector<BigUnsigned> g(1, mod_inverse(f[0] % modulus, modulus));
+	for (int m = 1; m < k; ) {
+		int m2 = min(2 * m, k);
+
+		vector<BigUnsigned> f_m(f.begin(), f.begin() + min((int)f.size(), m2));
+		vector<BigUnsigned> e = truncated_product(f_m, g, m2, modulus);
+		vector<BigUnsigned> h(e.begin() + m, e.end());
+		vector<BigUnsigned> t = truncated_product(g, h, m2 - m, modulus);
+
+		g.resize(m2);
+		for (int i = m; i < m2; i++)
+			g[i] = t[i - m].isZero() ? BigUnsigned(0) : modulus - t[i - m];
+		m = m2;
+	}
+	return g;
+}
+
+//////////////////////////////////////////////////////////////
+// Dispatch
+//////////////////////////////////////////////////////////////
+bool PolyMultiplier::nttFriendly(int n, BigUnsigned modulus) {
+	if (n < 2 || (n & (n - 1)) != 0 || modulus < 3)
+		return false;
+	return ((modulus - 1) % (2 * n)).isZero() && isPrime(modulus);
+}
+
+int PolyMultiplier::calibrationBits(BigUnsigned modulus) {
+	int bits = modulus.bitLength();
+	return (bits <= 32) ? 32 : ((bits + 31) / 32) * 32;
+}
+
+// Built once per (n, q) under that key's lock, so the root search does
+// not hold up products in other rings. Entries are never erased, so the
+// references stay valid.
+NTT& PolyMultiplier::cachedNTT(int n, BigUnsigned modulus) {
+	string key = to_string(n) + ":" + bigUnsignedToString(modulus);
+	mutex* key_lock;
+	{
+		lock_guard<mutex> guard(lock);
+		map<string, NTT>::iterator it = ntts.find(key);
+		if (it != ntts.end())
+			return it->second;
+		key_lock = &ntt_locks[key];
+	}
+
+	lock_guard<mutex> key_guard(*key_lock);
+	{
+		lock_guard<mutex> guard(lock);
+		map<string, NTT>::iterator it = ntts.find(key);
+		if (it != ntts.end())
+			return it->second;     // built while this call waited
+	}
+	NTT ntt(n, modulus, RNS(), true);
+
+	lock_guard<mutex> guard(lock);
+	return ntts.insert(make_pair(key, ntt)).first->second;
+}
+
+PolyMultAlgorithm PolyMultiplier::choose(int n, BigUnsigned modulus, bool negacyclic) {
+	if (n < CALIBRATION_MIN)
+		return POLYMULT_SCHOOLBOOK;
+
+	// concurrent first calls for a key wait for one calibration instead
+	// of timing alongside it, which would skew the crossovers
+	pair<int, bool> key(calibrationBits(modulus), negacyclic);
+	mutex* key_lock;
+	{
+		lock_guard<mutex> guard(lock);
+		key_lock = &calibration_locks[key];
+	}
+	{
+		lock_guard<mutex> key_guard(*key_lock);
+		bool calibrated;
+		{
+			lock_guard<mutex> guard(lock);
+			calibrated = (calibrations.find(key) != calibrations.end());
+		}
+		if (!calibrated)
+			calibrate(key.first, negacyclic);
+	}
+
+	// the entry for the next power of two, or the largest one measured
+	int index = 0;
+	while ((CALIBRATION_MIN << index) < n && (CALIBRATION_MIN << index) < CALIBRATION_MAX)
+		index++;
+
+	bool ntt_friendly = nttFriendly(n, modulus);     // a primality test, kept outside the lock
+
+	lock_guard<mutex> guard(lock);
+	map<pair<int, bool>, Calibration>::const_iterator it = calibrations.find(key);
+	if (it == calibrations.end())
+		return ntt_friendly ? POLYMULT_NTT : POLYMULT_KARATSUBA;     // calibration cancelled
+	const Calibration& c = it->second;
+	if (ntt_friendly && (c.best[index] == POLYMULT_NTT || n > CALIBRATION_MAX))
+		return POLYMULT_NTT;
+	return c.best_without_ntt[index];
+}
+
+// Times every algorithm for n = CALIBRATION_MIN ... CALIBRATION_MAX in
+// the given ring on a prime of modulus_bits bits with 2 * CALIBRATION_MAX
+// | q - 1 (best of three runs up to n = 128, where single runs are noisy)
+void PolyMultiplier::calibrate(int modulus_bits, bool negacyclic, bool print) {
+	typedef chrono::duration<double, micro> us;
+
+	BigUnsigned q = next_ntt_prime((BigUnsigned(1) << (modulus_bits - 1)) + 1, 2 * CALIBRATION_MAX);
+	Calibration c;
+	if (q.isZero())
+		return;     // prime search cancelled, the previous calibration stays
+
+	if (print)
+		cout << endl << "PolyMultiplier calibration, " << modulus_bits << "-bit modulus (q = " << q << "), "
+			 << (negacyclic ? "x^n + 1" : "x^n - 1") << ", microseconds:" << endl;
+
+	for (int n = CALIBRATION_MIN; n <= CALIBRATION_MAX; n *= 2) {
+		vector<BigUnsigned> A = sample_polynomial(n, q);
+		vector<BigUnsigned> B = sample_polynomial(n, q);
+		multiply(A, B, q, negacyclic, POLYMULT_NTT);      // NTT set up outside the timing
+
+		double best_time = 0, best_time_without_ntt = 0;
+		PolyMultAlgorithm best = POLYMULT_SCHOOLBOOK, best_without_ntt = POLYMULT_SCHOOLBOOK;
+		if (print)
+			cout << "n = " << n << ":";
+		for (int a = POLYMULT_SCHOOLBOOK; a <= POLYMULT_NTT; a++) {
+			PolyMultAlgorithm algorithm = (PolyMultAlgorithm)a;
+			double t = 0;
+			for (int run = 0; run < ((n <= 128) ? 3 : 1); run++) {
+				auto t0 = chrono::steady_clock::now();
+				multiply(A, B, q, negacyclic, algorithm);
+				double t_run = us(chrono::steady_clock::now() - t0).count();
+				if (run == 0 || t_run < t)
+					t = t_run;
+			}
+
+			if (a == POLYMULT_SCHOOLBOOK || t < best_time) {
+				best_time = t;
+				best      = algorithm;
+			}
+			if (algorithm != POLYMULT_NTT && (a == POLYMULT_SCHOOLBOOK || t < best_time_without_ntt)) {
+				best_time_without_ntt = t;
+				best_without_ntt      = algorithm;
+			}
+			if (print)
+				cout << " " << name(algorithm) << " " << t;
+		}
+		if (print)
+			cout << " -> " << name(best) << endl;
+
+		c.best.push_back(best);
+		c.best_without_ntt.push_back(best_without_ntt);
+	}
+
+	lock_guard<mutex> guard(lock);
+	calibrations[make_pair(modulus_bits, negacyclic)] = c;
+}
+
+string PolyMultiplier::name(PolyMultAlgorithm algorithm) {
+	switch (algorithm) {
+		case POLYMULT_SCHOOLBOOK: return "schoolbook";
+		case POLYMULT_KARATSUBA:  return "Karatsuba";
+		case POLYMULT_TOOM3:      return "Toom-3";
+		case POLYMULT_TOOM4:      return "Toom-4";
+		case POLYMULT_NTT:        return "NTT";
+		case POLYMULT_SPARSE:     return "sparse";
+		default:                  return "auto";
+	}
+}
+
+//////////////////////////////////////////////////////////////
+// Every algorithm against schoolbook, on NTT-friendly and
+// other moduli (powers of two, Kyber's q with n = 256) and on
+// lengths that are not powers of two
+//////////////////////////////////////////////////////////////
+bool PolyMultiplier::polyMultiplyTest(int n_tests) {
+	int n_correct = 0;
+	const int lengths[] = { 1, 3, 7, 16, 33, 64, 100, 128, 256 };
+	vector<BigUnsigned> moduli = { 12289, 8192, 3329, (BigUnsigned(1) << 61) - 1, next_ntt_prime((BigUnsigned(1) << 100) + 1, 512) };
+
+	for (int t = 0; t < n_tests; t++) {
+		int n = lengths[t % 9];
+		BigUnsigned q = moduli[(t / 9 + t) % moduli.size()];
+		bool negacyclic = (t % 2 == 0);
+
+		vector<BigUnsigned> A = sample_polynomial(n, q);
+		vector<BigUnsigned> B = sample_polynomial(n, q);
+		vector<BigUnsigned> expected = multiply(A, B, q, negacyclic, POLYMULT_SCHOOLBOOK);
+
+		bool correct = true;
+		for (int a = POLYMULT_KARATSUBA; a <= POLYMULT_AUTO; a++) {
+			if ((a == POLYMULT_NTT && !nttFriendly(n, q)) || a == POLYMULT_SPARSE)
+				continue;
+			if (!vectorsAreEqual(multiply(A, B, q, negacyclic, (PolyMultAlgorithm)a), expected)) {
+				cout << name((PolyMultAlgorithm)a) << " wrong for n = " << n << ", q = " << q << endl;
+				correct = false;
+			}
+		}
+
+		vector<BigUnsigned> linear = linearProduct(A, B, POLYMULT_TOOM4);
+		for (int i = 0; correct && i < n; i++) {
+			BigUnsigned c = linear[i] % q;
+			BigUnsigned wrapped = (i + n < linear.size()) ? linear[i + n] % q : BigUnsigned(0);
+			c = negacyclic ? (c + q - wrapped) % q : (c + wrapped) % q;
+			correct = (c == expected[i]);
+		}
+
+		if (correct)
+			n_correct++;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// f * seriesInverse(f) = 1 mod x^k, for powers of two, NTT
+// primes and wide moduli, and f longer or shorter than k
+//////////////////////////////////////////////////////////////
+bool PolyMultiplier::seriesInverseTest(int n_tests) {
+	int n_correct = 0;
+	const int lengths[] = { 1, 2, 5, 16, 100, 509, 512, 701 };
+	vector<BigUnsigned> moduli = { 2048, 12289, 3329, (BigUnsigned(1) << 61) - 1, BigUnsigned(1) << 64, next_ntt_prime((BigUnsigned(1) << 100) + 1, 512) };
+
+	for (int t = 0; t < n_tests; t++) {
+		int k = lengths[t % 8];
+		BigUnsigned q = moduli[t % moduli.size()];
+
+		vector<BigUnsigned> f = sample_polynomial(k + (t % 3) - 1 + (k == 1), q);
+		while (!areCoprimes(f[0], q))
+			f[0] = (f[0] + 1) % q;
+
+		vector<BigUnsigned> g = seriesInverse(f, k, q);
+		vector<BigUnsigned> fg = linearProduct(f, g);
+		bool correct = (g.size() == k);
+		for (int i = 0; correct && i < k; i++)
+			correct = (fg[i] % q == BigUnsigned(i == 0 ? 1 : 0));
+
+		if (correct)
+			n_correct++;
+		else
+			cout << "Series inverse wrong for k = " << k << ", q = " << q << endl;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// Ring inverse: one batch_mod_inverse against a mod_inverse per
+// evaluation (both with a forward and an inverse NTT), and
+// against a product. Series inverse: Newton against the
+// coefficient by coefficient recurrence g_i = -g_0 sum f_j g_(i-j).
+//////////////////////////////////////////////////////////////
+static vector<BigUnsigned> series_inverse_schoolbook(const vector<BigUnsigned>& f, int k, const BigUnsigned& q) {
+	vector<BigUnsigned> g(k);
+	g[0] = mod_inverse(f[0], q);
+	for (int i = 1; i < k; i++) {
+		BigUnsigned sum = 0;
+		for (int j = 1; j <= i && j < f.size(); j++)
+			sum += f[j] * g[i - j];
+		sum %= q;
+		g[i] = sum.isZero() ? BigUnsigned(0) : (g[0] * (q - sum)) % q;
+	}
+	return g;
+}
+
+void poly_inverse_benchmark(int n_runs) {
+	typedef chrono::duration<double, milli> ms;
+	cout << endl << endl << "Polynomial inverse benchmark (" << n_runs << " inverses each):" << endl;
+
+	const char* sets[2] = { "falcon512", "newhope1024" };     // n = 512 and 1024, q = 12289
+	for (int s = 0; s < 2; s++) {
+		NTT ntt = NTT::fromCatalog(sets[s]);
+		int n = ntt.vec_length.toInt();
+		BigUnsigned q = ntt.modulus;
+
+		vector<vector<BigUnsigned>> a(n_runs);
+		for (int r = 0; r < n_runs; r++) {
+			do
+				a[r] = sample_polynomial(n, q);
+			while (!Polynomial(a[r], ntt).invertible());
+		}
+
+		vector<vector<BigUnsigned>> batched(n_runs), each(n_runs);
+		auto t0 = chrono::steady_clock::now();
+		for (int r = 0; r < n_runs; r++)
+			batched[r] = Polynomial(a[r], ntt).inverse().coefficients();
+		auto t1 = chrono::steady_clock::now();
+		for (int r = 0; r < n_runs; r++) {
+			vector<BigUnsigned> e = Polynomial(a[r], ntt).evaluation();
+			for (int i = 0; i < n; i++)
+				e[i] = mod_inverse(e[i], q);
+			each[r] = Polynomial::fromEvaluation(e, ntt).coefficients();
+		}
+		auto t2 = chrono::steady_clock::now();
+		for (int r = 0; r < n_runs; r++)
+			(Polynomial(a[r], ntt) * Polynomial(a[(r + 1) % n_runs], ntt)).coefficients();
+		auto t3 = chrono::steady_clock::now();
+
+		bool same = true;
+		for (int r = 0; r < n_runs; r++)
+			same = same && vectorsAreEqual(batched[r], each[r]);
+
+		double t_batched = ms(t1 - t0).count() / n_runs;
+		double t_each    = ms(t2 - t1).count() / n_runs;
+		cout << sets[s] << " (n = " << n << ", q = " << q << ") ring inverse: " << t_batched << " ms batched, " << t_each
+			<< " ms one mod_inverse per evaluation (" << t_each / t_batched << "x), a product: " << ms(t3 - t2).count() / n_runs
+			<< " ms, " << (same ? "identical" : "DIFFERENT") << " results." << endl;
+	}
+
+	vector<BigUnsigned> moduli = { 2048, 12289 };
+	for (int k = 512; k <= 1024; k *= 2) {
+		for (int m = 0; m < moduli.size(); m++) {
+			BigUnsigned q = moduli[m];
+			vector<vector<BigUnsigned>> f(n_runs), newton(n_runs), recurrence(n_runs);
+			for (int r = 0; r < n_runs; r++) {
+				f[r] = sample_polynomial(k, q);
+				while (!areCoprimes(f[r][0], q))
+					f[r][0] = (f[r][0] + 1) % q;
+			}
+
+			auto t0 = chrono::steady_clock::now();
+			for (int r = 0; r < n_runs; r++)
+				newton[r] = PolyMultiplier::seriesInverse(f[r], k, q);
+			auto t1 = chrono::steady_clock::now();
+			for (int r = 0; r < n_runs; r++)
+				recurrence[r] = series_inverse_schoolbook(f[r], k, q);
+			auto t2 = chrono::steady_clock::now();
+
+			bool same = true;
+			for (int r = 0; r < n_runs; r++)
+				same = same && vectorsAreEqual(newton[r], recurrence[r]);
+
+			double t_newton = ms(t1 - t0).count() / n_runs;
+			double t_recurrence = ms(t2 - t1).count() / n_runs;
+			cout << "Inverse mod x^" << k << ", q = " << q << ": Newton " << t_newton << " ms, recurrence " << t_recurrence
+				<< " ms (" << t_recurrence / t_newton << "x), " << (same ? "identical" : "DIFFERENT") << " results." << endl;
+		}
+	}
+	cout << endl;
+}
+
+//////////////////////////////////////////////////////////////
+// Sparse products against schoolbook in both rings, for word
+// moduli (reduced once or per addition) and wide ones, and
+// POLYMULT_AUTO taking the sparse path for light operands
+//////////////////////////////////////////////////////////////
+bool PolyMultiplier::sparseMultiplyTest(int n_tests) {
+	int n_correct = 0;
+	const int lengths[] = { 1, 7, 64, 256, 1024 };
+	vector<BigUnsigned> moduli = { 3, 12289, (BigUnsigned(1) << 62) + 1, (BigUnsigned(1) << 63) - 25, next_ntt_prime((BigUnsigned(1) << 100) + 1, 2048) };
+
+	for (int t = 0; t < n_tests; t++) {
+		int n = lengths[t % 5];
+		BigUnsigned q = moduli[(t / 5 + t) % moduli.size()];
+		bool negacyclic = (t % 2 == 0);
+
+		SparseTernary S = SparseTernary::sample(n, (t % 3 == 0) ? n : (n + 7) / 8);
+		vector<BigUnsigned> s = S.toDense(q);
+		vector<BigUnsigned> A = sample_polynomial(n, q);
+		vector<BigUnsigned> expected = multiply(s, A, q, negacyclic, POLYMULT_SCHOOLBOOK);
+
+		SparseTernary T;
+		bool correct = SparseTernary::fromDense(s, q, T, n) && T.weight() == S.weight();
+		correct = correct && vectorsAreEqual(sparseMultiply(S, A, q, negacyclic), expected);
+		correct = correct && vectorsAreEqual(multiply(A, s, q, negacyclic, POLYMULT_SPARSE), expected);
+		correct = correct && vectorsAreEqual(multiply(s, A, q, negacyclic, POLYMULT_AUTO), expected);
+
+		if (correct)
+			n_correct++;
+		else
+			cout << "Sparse product wrong for n = " << n << ", weight " << S.weight() << ", q = " << q << endl;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// A ternary operand of weight h times a dense one, against the
+// NTT product (set up outside the timing) of the same operands
+//////////////////////////////////////////////////////////////
+void sparse_multiply_benchmark(int n_runs) {
+	typedef chrono::duration<double, milli> ms;
+	cout << endl << endl << "Sparse multiplication benchmark (" << n_runs << " products each):" << endl;
+
+	const int weights[] = { 32, 64, 128, 256 };
+	vector<BigUnsigned> moduli = { next_ntt_prime(BigUnsigned(1) << 30, 8192), next_ntt_prime(BigUnsigned(1) << 59, 8192), next_ntt_prime(BigUnsigned(1) << 100, 8192) };
+	for (int m = 0; m < moduli.size(); m++) {
+		BigUnsigned q = moduli[m];
+		for (int n = 1024; n <= 4096; n *= 2) {
+			vector<BigUnsigned> A = sample_polynomial(n, q);
+			PolyMultiplier::multiply(A, A, q, true, POLYMULT_NTT);
+
+			cout << endl << "n = " << n << ", q = " << q << " (" << q.bitLength() << " bits):" << endl;
+			for (int w = 0; w < 4; w++) {
+				SparseTernary S = SparseTernary::sample(n, weights[w]);
+				vector<BigUnsigned> s = S.toDense(q);
+				vector<BigUnsigned> C_sparse, C_ntt;
+
+				auto t0 = chrono::steady_clock::now();
+				for (int r = 0; r < n_runs; r++)
+					C_sparse = PolyMultiplier::sparseMultiply(S, A, q);
+				auto t1 = chrono::steady_clock::now();
+				for (int r = 0; r < n_runs; r++)
+					C_ntt = PolyMultiplier::multiply(s, A, q, true, POLYMULT_NTT);
+				auto t2 = chrono::steady_clock::now();
+
+				double t_sparse = ms(t1 - t0).count() / n_runs;
+				double t_ntt    = ms(t2 - t1).count() / n_runs;
+				cout << "h = " << weights[w] << ": sparse " << t_sparse << " ms, NTT " << t_ntt << " ms (" << t_ntt / t_sparse << "x), "
+					<< (vectorsAreEqual(C_sparse, C_ntt) ? "identical" : "DIFFERENT") << " results, auto picks "
+					<< ((S.weight() <= PolyMultiplier::sparseThreshold(n, q)) ? "sparse" : "dense") << "." << endl;
+			}
+		}
+	}
+	cout << endl;
+}
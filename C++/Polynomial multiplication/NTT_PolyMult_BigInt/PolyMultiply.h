@@ -0,0 +1,116 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include "NTT.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Polynomial multiplication with or without the NTT
+//
+// PolyMultiplier::multiply() multiplies in Z_q[x]/(x^n + 1)
+// (negacyclic) or Z_q[x]/(x^n - 1) (cyclic) with
+//   schoolbook   n^2 coefficient products
+//   Karatsuba    3 half-size products, about n^1.58
+//   Toom-3       5 third-size products, about n^1.46
+//   Toom-4       7 quarter-size products, about n^1.40
+//   NTT          Polynomial products with a cached NTT, for
+//                prime q with 2n | q - 1 and n a power of two
+// The first four work for any q and any n: they compute the
+// integer product of the coefficients (signed between the Toom
+// evaluation and interpolation, whose divisions are exact) and
+// reduce once at the end, so moduli the NTT cannot use, such as
+// powers of two, are fine. Their recursion ends in schoolbook
+// below RECURSION_LIMIT coefficients.
+//
+// POLYMULT_AUTO picks by measurement: the first call for a
+// modulus size (bit length rounded up to a multiple of 32) and
+// ring runs calibrate(), which times every algorithm for n = 8
+// ... 512 in that ring on an NTT-friendly prime of that size,
+// and keeps the fastest per n with and without the NTT. Later
+// calls only look it up.
+//
+// Before that, POLYMULT_AUTO looks for a ternary operand with at
+// most sparseThreshold(n) nonzero coefficients and multiplies it
+// with sparseMultiply(): for each nonzero, the other operand is
+// added to or subtracted from the result, rotated, in two
+// contiguous runs (the second one negated in x^n + 1). That is
+// h * n additions and no products. Below 2^63 the runs are plain
+// word loops the compiler vectorizes, and when h * q fits in a
+// word the result is only reduced once at the end.
+//
+// seriesInverse() needs no NTT-friendly q (NTRU's q = 2048, for
+// instance): Newton's g <- g (2 - f g) doubles the number of
+// correct coefficients per step, with the products done exactly
+// by MultiPrimeNTT and reduced mod q. In Z_q[x]/(x^n + 1) with
+// an NTT-friendly q, Polynomial::inverse() is cheaper.
+//////////////////////////////////////////////////////////////
+enum PolyMultAlgorithm { POLYMULT_SCHOOLBOOK, POLYMULT_KARATSUBA, POLYMULT_TOOM3, POLYMULT_TOOM4, POLYMULT_NTT, POLYMULT_SPARSE, POLYMULT_AUTO };
+
+// Ternary polynomial (secret keys, errors) as index lists: +1 at plus, -1 at minus
+struct SparseTernary
+{
+	int n;
+	std::vector<int> plus, minus;
+
+	SparseTernary() : n(0) {}
+	int weight() const { return plus.size() + minus.size(); }
+
+	// false if some coefficient is not 0, 1 or q - 1, or more than max_weight are nonzero
+	static bool fromDense(const std::vector<BigUnsigned>& A, BigUnsigned modulus, SparseTernary& S, int max_weight);
+	std::vector<BigUnsigned> toDense(BigUnsigned modulus) const;
+	static SparseTernary sample(int n, int weight);     // weight distinct positions, random signs
+};
+
+class PolyMultiplier
+{
+
+public:
+	static const int RECURSION_LIMIT = 16;     // schoolbook at or below this many coefficients
+	static const int CALIBRATION_MIN = 8;      // n timed by calibrate(), powers of two
+	static const int CALIBRATION_MAX = 512;
+
+	// A * B mod (x^n -/+ 1, q), n = A.size() = B.size(), coefficients below q
+	static std::vector<BigUnsigned> multiply(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, BigUnsigned modulus,
+		bool negacyclic = true, PolyMultAlgorithm algorithm = POLYMULT_AUTO);
+
+	// Integer product, A.size() + B.size() - 1 coefficients (any non-NTT algorithm)
+	static std::vector<BigUnsigned> linearProduct(const std::vector<BigUnsigned>& A, const std::vector<BigUnsigned>& B, PolyMultAlgorithm algorithm = POLYMULT_KARATSUBA);
+
+	// S * A mod (x^n -/+ 1, q) for ternary S, A of length n
+	static std::vector<BigUnsigned> sparseMultiply(const SparseTernary& S, const std::vector<BigUnsigned>& A, BigUnsigned modulus, bool negacyclic = true);
+	static int sparseThreshold(int n, BigUnsigned modulus);
+
+	// f^-1 mod (x^k, q) by Newton iteration, for any q with f[0] a unit mod q
+	static std::vector<BigUnsigned> seriesInverse(const std::vector<BigUnsigned>& f, int k, BigUnsigned modulus);
+
+	static PolyMultAlgorithm choose(int n, BigUnsigned modulus, bool negacyclic);   // what POLYMULT_AUTO runs
+	static bool nttFriendly(int n, BigUnsigned modulus);
+	static void calibrate(int modulus_bits, bool negacyclic = true, bool print = false);
+	static std::string name(PolyMultAlgorithm algorithm);
+
+	static bool polyMultiplyTest(int n_tests);
+	static bool seriesInverseTest(int n_tests);
+	static bool sparseMultiplyTest(int n_tests);
+
+private:
+	struct Calibration {
+		std::vector<PolyMultAlgorithm> best;               // index log2(n / CALIBRATION_MIN)
+		std::vector<PolyMultAlgorithm> best_without_ntt;
+	};
+	static std::map<std::pair<int, bool>, Calibration> calibrations;   // by (modulus bits rounded up to 32, negacyclic)
+	static std::map<std::string, NTT> ntts;                // by (n, q), for the NTT path
+	static std::mutex lock;                                // guards the maps, not the work
+	static std::map<std::pair<int, bool>, std::mutex> calibration_locks;   // one calibration per key at a time
+	static std::map<std::string, std::mutex> ntt_locks;                    // one NTT construction per key at a time
+
+	static NTT& cachedNTT(int n, BigUnsigned modulus);
+	static int calibrationBits(BigUnsigned modulus);
+};
+
+// Ring inverses (NTT-friendly q) and Newton series inverses at n = 512 and 1024
+void poly_inverse_benchmark(int n_runs = 5);
+
+// Sparse ternary times dense against the NTT, h = 32 ... 256 and n = 1024 ... 4096
+void sparse_multiply_benchmark(int n_runs = 5);
@@ -0,0 +1,598 @@
+#include "Polynomial.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "general_functions.h"
+#include "StaticNTT.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+using namespace std;
+
+atomic<unsigned long> Polynomial::forward_transforms(0);
+atomic<unsigned long> Polynomial::inverse_transforms(0);
+
+//////////////////////////////////////////////////////////////
+// Construction
+//////////////////////////////////////////////////////////////
+Polynomial::Polynomial() : ntt(NULL), ring(NEGACYCLIC), coeffs_valid(false), evals_valid(false) {}
+
+Polynomial::Polynomial(NTT& ntt, Ring ring) : ntt(&ntt), ring(ring), coeffs_valid(true), evals_valid(true) {
+	// zero transforms to zero, so both forms are known
+	int n = ntt.vec_length.toInt();
+	coeffs.assign(n, BigUnsigned(0));
+	evals.assign(n, BigUnsigned(0));
+}
+
+Polynomial::Polynomial(vector<BigUnsigned> coefficients, NTT& ntt, Ring ring) : ntt(&ntt), ring(ring), coeffs_valid(false), evals_valid(false) {
+	setCoefficients(coefficients);
+}
+
+Polynomial Polynomial::fromEvaluation(vector<BigUnsigned> evaluation, NTT& ntt, Ring ring) {
+	Polynomial P;
+	P.ntt  = &ntt;
+	P.ring = ring;
+	if (evaluation.size() != ntt.vec_length.toInt()) {
+		cout << "ERROR: evaluation of length " << evaluation.size() << " for an NTT of length " << ntt.vec_length << "." << endl;
+		return P;
+	}
+	for (int i = 0; i < evaluation.size(); i++)
+		evaluation[i] %= ntt.modulus;
+	P.evals       = evaluation;
+	P.evals_valid = true;
+	return P;
+}
+
+//////////////////////////////////////////////////////////////
+// Forms
+//////////////////////////////////////////////////////////////
+const vector<BigUnsigned>& Polynomial::coefficients() const {
+	toCoefficients();
+	return coeffs;
+}
+
+const vector<BigUnsigned>& Polynomial::evaluation() const {
+	toEvaluation();
+	return evals;
+}
+
+BigUnsigned Polynomial::coefficient(int i) const {
+	return coefficients()[i];
+}
+
+int Polynomial::size() const {
+	if (coeffs_valid)
+		return coeffs.size();
+	return evals.size();
+}
+
+void Polynomial::setCoefficients(vector<BigUnsigned> coefficients) {
+	if (ntt == NULL) {
+		cout << "ERROR: polynomial has no NTT." << endl;
+		return;
+	}
+	if (coefficients.size() != ntt->vec_length.toInt()) {
+		cout << "ERROR: " << coefficients.size() << " coefficients for an NTT of length " << ntt->vec_length << "." << endl;
+		return;
+	}
+	for (int i = 0; i < coefficients.size(); i++)
+		coefficients[i] %= ntt->modulus;
+
+	coeffs       = coefficients;
+	coeffs_valid = true;
+	evals_valid  = false;
+	evals.clear();
+}
+
+void Polynomial::setCoefficient(int i, BigUnsigned value) {
+	toCoefficients();
+	coeffs[i]   = value % ntt->modulus;
+	evals_valid = false;
+	evals.clear();
+}
+
+void Polynomial::toEvaluation() const {
+	if (evals_valid || !coeffs_valid)
+		return;
+
+	if (ring == NEGACYCLIC)
+		evals = ntt->calculate(mult_by_power(coeffs, ntt->phi, ntt->modulus), false, true);
+	else
+		evals = ntt->calculate(coeffs, false, true);
+	evals_valid = true;
+	forward_transforms++;
+}
+
+void Polynomial::toCoefficients() const {
+	if (coeffs_valid || !evals_valid)
+		return;
+
+	coeffs = ntt->calculate(evals, true, true);
+	if (ring == NEGACYCLIC)
+		coeffs = mult_by_power(coeffs, ntt->phi_inv, ntt->modulus);
+	coeffs_valid = true;
+	inverse_transforms++;
+}
+
+//////////////////////////////////////////////////////////////
+// Arithmetic
+//////////////////////////////////////////////////////////////
+bool Polynomial::compatible(const Polynomial& B, const char* op) const {
+	if (ntt == NULL || ntt != B.ntt || ring != B.ring || size() != B.size()) {
+		cout << "ERROR: polynomial " << op << " needs operands with the same NTT and ring." << endl;
+		return false;
+	}
+	return true;
+}
+
+Polynomial Polynomial::operator*(const Polynomial& B) const {
+	if (!compatible(B, "*"))
+		return Polynomial();
+
+	Polynomial C;
+	C.ntt         = ntt;
+	C.ring        = ring;
+	C.evals       = hadamard_product(evaluation(), B.evaluation(), ntt->modulus);
+	C.evals_valid = true;
+	return C;
+}
+
+// Adds in whichever form both operands hold (both forms when they
+// hold both), otherwise in evaluation form where products are cheap.
+Polynomial Polynomial::combine(const Polynomial& B, bool subtract) const {
+	if (!compatible(B, subtract ? "-" : "+"))
+		return Polynomial();
+
+	bool in_coeffs = coeffs_valid && B.coeffs_valid;
+	bool in_evals  = evals_valid && B.evals_valid;
+	if (!in_coeffs && !in_evals) {
+		toEvaluation();
+		B.toEvaluation();
+		in_evals = true;
+	}
+
+	const BigUnsigned& q = ntt->modulus;
+	Polynomial C;
+	C.ntt  = ntt;
+	C.ring = ring;
+	for (int form = 0; form < 2; form++) {
+		if (!(form == 0 ? in_coeffs : in_evals))
+			continue;
+		const vector<BigUnsigned>& a = (form == 0) ? coeffs : evals;
+		const vector<BigUnsigned>& b = (form == 0) ? B.coeffs : B.evals;
+		vector<BigUnsigned>& c = (form == 0) ? C.coeffs : C.evals;
+
+		c.resize(a.size());
+		for (int i = 0; i < a.size(); i++) {
+			if (subtract)
+				c[i] = (a[i] >= b[i]) ? a[i] - b[i] : a[i] + (q - b[i]);
+			else {
+				c[i] = a[i] + b[i];
+				if (c[i] >= q)
+					c[i] -= q;
+			}
+		}
+	}
+	C.coeffs_valid = in_coeffs;
+	C.evals_valid  = in_evals;
+	return C;
+}
+
+Polynomial Polynomial::operator+(const Polynomial& B) const {
+	return combine(B, false);
+}
+
+Polynomial Polynomial::operator-(const Polynomial& B) const {
+	return combine(B, true);
+}
+
+Polynomial& Polynomial::operator*=(const Polynomial& B) {
+	*this = *this * B;
+	return *this;
+}
+
+Polynomial& Polynomial::operator+=(const Polynomial& B) {
+	*this = *this + B;
+	return *this;
+}
+
+Polynomial& Polynomial::operator-=(const Polynomial& B) {
+	*this = *this - B;
+	return *this;
+}
+
+bool Polynomial::operator==(const Polynomial& B) const {
+	if (evals_valid && B.evals_valid)
+		return vectorsAreEqual(evals, B.evals);   // the NTT is a bijection
+	return vectorsAreEqual(coefficients(), B.coefficients());
+}
+
+//////////////////////////////////////////////////////////////
+// Fused inner product
+//
+// Every operand is brought to evaluation form (once, and kept),
+// the pointwise products of all pairs are added up unreduced and
+// each coefficient is reduced once, instead of a reduced (and
+// allocated) hadamard_product per term. The result stays in
+// evaluation form, so its coefficients cost a single inverse NTT
+// however many terms there are.
+//
+// For q < 2^63 the sum is kept in two words: k products stay
+// below q * 2^64 for k <= (2^64 - 1) / q, and then one Montgomery
+// reduction and a product with 2^128 mod q give the sum mod q.
+// Wider moduli add up in a BigUnsigned.
+//////////////////////////////////////////////////////////////
+Polynomial Polynomial::innerProduct(const vector<Polynomial>& A, const vector<Polynomial>& B) {
+	if (A.size() != B.size() || A.empty()) {
+		cout << "ERROR: inner product needs the same number (at least one) of polynomials on both sides." << endl;
+		return Polynomial();
+	}
+	for (int t = 0; t < A.size(); t++) {
+		if (!A[0].compatible(A[t], "inner product") || !A[0].compatible(B[t], "inner product"))
+			return Polynomial();
+	}
+
+	NTT* ntt = A[0].ntt;
+	const BigUnsigned& q = ntt->modulus;
+	int n_terms = A.size();
+	int n       = A[0].size();
+
+	vector<const vector<BigUnsigned>*> a(n_terms), b(n_terms);
+	for (int t = 0; t < n_terms; t++) {
+		a[t] = &A[t].evaluation();
+		b[t] = &B[t].evaluation();
+	}
+
+	Polynomial C;
+	C.ntt  = ntt;
+	C.ring = A[0].ring;
+	C.evals.resize(n);
+
+	if (q.bitLength() < 64 && q % 2 == 1) {
+		typedef static_ntt::word word;
+		word q_w    = to_u64(q);
+		word q_inv  = static_ntt::neg_inverse(q_w);
+		word r2     = static_ntt::r_squared(q_w);
+		word limit  = ~word(0) / q_w;           // products per accumulator before it is folded
+		vector<word> a_w(n_terms * n), b_w(n_terms * n);
+		for (int t = 0; t < n_terms; t++) {
+			for (int i = 0; i < n; i++) {
+				a_w[t * n + i] = to_u64((*a[t])[i]);
+				b_w[t * n + i] = to_u64((*b[t])[i]);
+			}
+		}
+
+		for (int i = 0; i < n; i++) {
+			static_ntt::Wide sum = { 0, 0 };
+			word count = 0;
+			for (int t = 0; t < n_terms; t++) {
+				if (count == limit) {
+					// sum mod q, which counts as one more term
+					sum   = static_ntt::Wide{ static_ntt::mont_mul_rt(static_ntt::redc(sum, q_w, q_inv), r2, q_w, q_inv), 0 };
+					count = 1;
+				}
+				static_ntt::Wide p = static_ntt::mul_wide(a_w[t * n + i], b_w[t * n + i]);
+				sum.lo += p.lo;
+				sum.hi += p.hi + (sum.lo < p.lo);
+				count++;
+			}
+			C.evals[i] = from_u64(static_ntt::mont_mul_rt(static_ntt::redc(sum, q_w, q_inv), r2, q_w, q_inv));
+		}
+	}
+	else {
+		BigUnsigned sum;
+		for (int i = 0; i < n; i++) {
+			sum = 0;
+			for (int t = 0; t < n_terms; t++)
+				sum += (*a[t])[i] * (*b[t])[i];
+			C.evals[i] = sum % q;
+		}
+	}
+	C.evals_valid = true;
+	return C;
+}
+
+//////////////////////////////////////////////////////////////
+// Inverse
+//
+// The NTT maps the ring onto n copies of Z_q, so a is a unit
+// exactly when none of its evaluations is zero, and a^-1 is the
+// pointwise inverse. The n inverses share one mod_inverse
+// (batch_mod_inverse) and the result stays in evaluation form,
+// ready for the products it is usually wanted for.
+//////////////////////////////////////////////////////////////
+bool Polynomial::invertible() const {
+	if (ntt == NULL)
+		return false;
+	const vector<BigUnsigned>& e = evaluation();
+	for (int i = 0; i < e.size(); i++) {
+		if (e[i].isZero())
+			return false;
+	}
+	return true;
+}
+
+Polynomial Polynomial::inverse() const {
+	if (ntt == NULL) {
+		cout << "ERROR: polynomial has no NTT." << endl;
+		return Polynomial();
+	}
+
+	Polynomial C;
+	C.ntt   = ntt;
+	C.ring  = ring;
+	C.evals = evaluation();
+	if (!batch_mod_inverse(C.evals, ntt->modulus)) {
+		cout << "ERROR: polynomial is not invertible (an evaluation is zero)." << endl;
+		return Polynomial();
+	}
+	C.evals_valid = true;
+	return C;
+}
+
+//////////////////////////////////////////////////////////////
+// Automorphisms
+//
+// In coefficient form a(X^k) moves coefficient i to i*k mod 2n
+// (mod n in the cyclic ring), negated when it lands at or above
+// n since x^n = -1. In evaluation form the NTT's index map does
+// the same without touching the values.
+//////////////////////////////////////////////////////////////
+static vector<BigUnsigned> automorphism_coefficients(const vector<BigUnsigned>& a, int k, const BigUnsigned& q, bool negacyclic) {
+	long long n = a.size();
+	long long m = negacyclic ? 2 * n : n;
+	long long k_red = ((k % m) + m) % m;
+
+	vector<BigUnsigned> out(n);
+	for (long long i = 0; i < n; i++) {
+		long long t = i * k_red % m;
+		if (t < n)
+			out[t] = a[i];
+		else
+			out[t - n] = a[i].isZero() ? BigUnsigned(0) : q - a[i];
+	}
+	return out;
+}
+
+Polynomial Polynomial::automorphism(int k) const {
+	if (ntt == NULL) {
+		cout << "ERROR: polynomial has no NTT." << endl;
+		return Polynomial();
+	}
+	if (ntt->automorphismMap(k, ring == NEGACYCLIC, true).empty())
+		return Polynomial();
+
+	Polynomial C;
+	C.ntt  = ntt;
+	C.ring = ring;
+	if (evals_valid)
+		C.evals = ntt->automorphism(evals, k, ring == NEGACYCLIC, true);
+	if (coeffs_valid)
+		C.coeffs = automorphism_coefficients(coeffs, k, ntt->modulus, ring == NEGACYCLIC);
+	C.evals_valid  = evals_valid;
+	C.coeffs_valid = coeffs_valid;
+	return C;
+}
+
+//////////////////////////////////////////////////////////////
+// Test against schoolbook multiplication, and count transforms
+// when one operand is reused
+//////////////////////////////////////////////////////////////
+static vector<BigUnsigned> schoolbook_multiply(const vector<BigUnsigned>& A, const vector<BigUnsigned>& B, const BigUnsigned& q, bool negacyclic) {
+	int n = A.size();
+	vector<BigUnsigned> C(n, BigUnsigned(0));
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			BigUnsigned p = (A[i] * B[j]) % q;
+			int k = i + j;
+			if (k < n)
+				C[k] = (C[k] + p) % q;
+			else if (negacyclic)
+				C[k - n] = (C[k - n] + q - p) % q;
+			else
+				C[k - n] = (C[k - n] + p) % q;
+		}
+	}
+	return C;
+}
+
+bool Polynomial::polynomialTest(NTT& ntt, int n_tests) {
+	int n_correct = 0;
+	BigUnsigned q = ntt.modulus;
+
+	for (int t = 0; t < n_tests; t++) {
+		Ring ring = (t % 2 == 0) ? NEGACYCLIC : CYCLIC;
+		bool negacyclic = (ring == NEGACYCLIC);
+
+		vector<BigUnsigned> a = sample_polynomial(ntt.vec_length, q);
+		vector<BigUnsigned> b = sample_polynomial(ntt.vec_length, q);
+		vector<BigUnsigned> c = sample_polynomial(ntt.vec_length, q);
+		Polynomial B(b, ntt, ring);
+		Polynomial C(c, ntt, ring);
+
+		// B is fixed: after its first use a product costs one forward and one inverse NTT
+		bool product_ok = vectorsAreEqual((Polynomial(c, ntt, ring) * B).coefficients(), schoolbook_multiply(c, b, q, negacyclic));
+		unsigned long f0 = forward_transforms, i0 = inverse_transforms;
+		Polynomial AB = Polynomial(a, ntt, ring) * B;
+		product_ok = product_ok && vectorsAreEqual(AB.coefficients(), schoolbook_multiply(a, b, q, negacyclic));
+		bool counts_ok = (forward_transforms - f0 == 1) && (inverse_transforms - i0 == 1);
+
+		// a*b + c and a*b - c, then back in coefficient form once
+		vector<BigUnsigned> ab = AB.coefficients();
+		vector<BigUnsigned> sum(ab.size()), diff(ab.size());
+		for (int i = 0; i < ab.size(); i++) {
+			sum[i]  = (ab[i] + c[i]) % q;
+			diff[i] = (ab[i] + q - c[i]) % q;
+		}
+		bool sums_ok = vectorsAreEqual((AB + C).coefficients(), sum) && vectorsAreEqual((AB - C).coefficients(), diff);
+
+		// mutating B drops its cached evaluation form
+		B.setCoefficient(0, b[0] + 1);
+		b[0] = (b[0] + 1) % q;
+		bool mutate_ok = !B.hasEvaluation() && vectorsAreEqual((Polynomial(a, ntt, ring) * B).coefficients(), schoolbook_multiply(a, b, q, negacyclic));
+
+		// evaluation form in, coefficients out
+		bool eval_ok = vectorsAreEqual(fromEvaluation(C.evaluation(), ntt, ring).coefficients(), c);
+
+		if (product_ok && counts_ok && sums_ok && mutate_ok && eval_ok)
+			n_correct++;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// Inner product against schoolbook, one inverse NTT for the
+// whole sum, and timed against a product (and inverse NTT) per
+// term added up in coefficient form
+//////////////////////////////////////////////////////////////
+bool Polynomial::innerProductTest(NTT& ntt, int n_tests, int n_terms) {
+	int n_correct = 0;
+	double t_fused = 0, t_terms = 0;
+	BigUnsigned q = ntt.modulus;
+
+	for (int test = 0; test < n_tests; test++) {
+		Ring ring = (test % 2 == 0) ? NEGACYCLIC : CYCLIC;
+
+		vector<vector<BigUnsigned>> a(n_terms), b(n_terms);
+		vector<BigUnsigned> expected(ntt.vec_length.toInt(), BigUnsigned(0));
+		for (int t = 0; t < n_terms; t++) {
+			a[t] = sample_polynomial(ntt.vec_length, q);
+			b[t] = sample_polynomial(ntt.vec_length, q);
+			vector<BigUnsigned> p = schoolbook_multiply(a[t], b[t], q, ring == NEGACYCLIC);
+			for (int i = 0; i < expected.size(); i++)
+				expected[i] = (expected[i] + p[i]) % q;
+		}
+
+		auto t0 = chrono::steady_clock::now();
+		vector<Polynomial> A, B;
+		for (int t = 0; t < n_terms; t++) {
+			A.push_back(Polynomial(a[t], ntt, ring));
+			B.push_back(Polynomial(b[t], ntt, ring));
+		}
+		unsigned long i0 = inverse_transforms;
+		vector<BigUnsigned> fused = innerProduct(A, B).coefficients();
+		bool one_inverse = (inverse_transforms - i0 == 1);
+		auto t1 = chrono::steady_clock::now();
+
+		Polynomial sum(ntt, ring);
+		for (int t = 0; t < n_terms; t++) {
+			Polynomial P = Polynomial(a[t], ntt, ring) * Polynomial(b[t], ntt, ring);
+			P.coefficients();
+			sum = sum + P;
+		}
+		auto t2 = chrono::steady_clock::now();
+		t_fused += chrono::duration<double, milli>(t1 - t0).count();
+		t_terms += chrono::duration<double, milli>(t2 - t1).count();
+
+		if (one_inverse && vectorsAreEqual(fused, expected) && vectorsAreEqual(sum.coefficients(), expected))
+			n_correct++;
+	}
+
+	cout << "Inner products of " << n_terms << " terms: " << t_fused << " ms fused, " << t_terms << " ms one product per term." << endl;
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// a * a^-1 = 1 and b * a * a^-1 = b in both rings, and a
+// polynomial with a zero evaluation reported as not invertible
+//////////////////////////////////////////////////////////////
+bool Polynomial::inverseTest(NTT& ntt, int n_tests) {
+	int n_correct = 0;
+	BigUnsigned q = ntt.modulus;
+	int n = ntt.vec_length.toInt();
+
+	vector<BigUnsigned> one(n, BigUnsigned(0));
+	one[0] = 1;
+
+	for (int t = 0; t < n_tests; t++) {
+		Ring ring = (t % 2 == 0) ? NEGACYCLIC : CYCLIC;
+
+		Polynomial A(sample_polynomial(n, q), ntt, ring);
+		while (!A.invertible())
+			A = Polynomial(sample_polynomial(n, q), ntt, ring);
+		vector<BigUnsigned> b = sample_polynomial(n, q);
+		Polynomial B(b, ntt, ring);
+
+		Polynomial A_inv = A.inverse();
+		bool correct = vectorsAreEqual((A * A_inv).coefficients(), one) && vectorsAreEqual((B * A * A_inv).coefficients(), b);
+
+		vector<BigUnsigned> e = A.evaluation();
+		e[t % n] = 0;
+		correct = correct && !fromEvaluation(e, ntt, ring).invertible();
+
+		if (correct)
+			n_correct++;
+	}
+
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
+
+//////////////////////////////////////////////////////////////
+// Automorphisms in evaluation form against the coefficient
+// definition, on BigUnsigned, word and RNS evaluations, and
+// timed against an inverse NTT, a coefficient permutation and
+// a forward NTT
+//////////////////////////////////////////////////////////////
+bool Polynomial::automorphismTest(NTT& ntt, int n_tests) {
+	typedef chrono::duration<double, milli> ms;
+	int n_correct = 0;
+	double t_evaluation = 0, t_transforms = 0;
+	BigUnsigned q = ntt.modulus;
+	int n = ntt.vec_length.toInt();
+
+	for (int t = 0; t < n_tests; t++) {
+		Ring ring = (t % 2 == 0) ? NEGACYCLIC : CYCLIC;
+		bool negacyclic = (ring == NEGACYCLIC);
+		int k = (t % 4 == 1) ? -1 : 2 * (rand() % n) + 1;    // -1 is the conjugation
+
+		vector<BigUnsigned> a = sample_polynomial(n, q);
+		vector<BigUnsigned> expected = automorphism_coefficients(a, k, q, negacyclic);
+		vector<BigUnsigned> expected_evals = Polynomial(expected, ntt, ring).evaluation();
+
+		// evaluation form only: permuted without a forward transform
+		Polynomial A = fromEvaluation(Polynomial(a, ntt, ring).evaluation(), ntt, ring);
+		unsigned long f0 = forward_transforms, i0 = inverse_transforms;
+		auto t0 = chrono::steady_clock::now();
+		Polynomial B = A.automorphism(k);
+		auto t1 = chrono::steady_clock::now();
+		bool correct = (forward_transforms == f0 && inverse_transforms == i0) && vectorsAreEqual(B.evaluation(), expected_evals);
+		correct = correct && vectorsAreEqual(B.coefficients(), expected);
+
+		// the naive route
+		auto t2 = chrono::steady_clock::now();
+		Polynomial C(automorphism_coefficients(fromEvaluation(A.evaluation(), ntt, ring).coefficients(), k, q, negacyclic), ntt, ring);
+		C.evaluation();
+		auto t3 = chrono::steady_clock::now();
+		t_evaluation += ms(t1 - t0).count();
+		t_transforms += ms(t3 - t2).count();
+
+		// coefficient form only
+		correct = correct && vectorsAreEqual(Polynomial(a, ntt, ring).automorphism(k).coefficients(), expected);
+
+		// word evaluations
+		if (q.bitLength() <= 64) {
+			vector<unsigned long long> e(n), expected_w(n);
+			for (int i = 0; i < n; i++) {
+				e[i]          = to_u64(A.evaluation()[i]);
+				expected_w[i] = to_u64(expected_evals[i]);
+			}
+			correct = correct && (ntt.automorphism(e, k, negacyclic, true) == expected_w);
+		}
+
+		// RNS evaluations, residues per coefficient
+		if (!ntt.rns.bases.empty()) {
+			vector<vector<BigUnsigned>> e_rns = ntt.rns.forwardConverter_polynomial(A.evaluation(), ntt.rns.bases);
+			correct = correct && vectorsAreEqual(ntt.rns.reverseConverter_polynomial(ntt.automorphism(e_rns, k, negacyclic, true), ntt.rns.bases), expected_evals);
+		}
+
+		if (correct)
+			n_correct++;
+	}
+
+	cout << "Automorphisms: " << t_evaluation / n_tests << " ms in evaluation form, " << t_transforms / n_tests << " ms through coefficient form." << endl;
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	return n_correct == n_tests;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include "NTT.h"
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Polynomial in Z_q[x]/(x^n - 1) or Z_q[x]/(x^n + 1)
+//
+// Holds its coefficients, its evaluation (NTT) form, or both.
+// A form is computed from the other only when an operation needs
+// it and is then kept, so an operand that is multiplied again and
+// again (a public key, a matrix entry) is transformed once:
+//
+//     Polynomial B(b, ntt);          // fixed operand
+//     for (...) {
+//         Polynomial C = Polynomial(a, ntt) * B;   // forward NTT of a
+//         C.coefficients();                        // inverse NTT
+//     }
+//
+// Products are returned in evaluation form only, so a chain of
+// products and sums is only brought back when coefficients are
+// read. Changing a coefficient drops the cached evaluation form.
+//
+// The ring is the cyclic one of polynomial_multiply() or the
+// negacyclic one of negative_wrapped_convolution() (inputs scaled
+// by powers of phi). The NTT is not owned and must outlive every
+// polynomial using it; operands must share the NTT and the ring.
+//
+// The evaluation form is in bit reversed order (NTT::calculate
+// with bitreversed): index j holds the value at w_n^bitrev(j), or
+// phi^(2 bitrev(j) + 1) in the negacyclic ring. Products, sums
+// and inverses are pointwise and never see the order, so no
+// transform permutes. evaluation() and fromEvaluation() use that
+// order too.
+//////////////////////////////////////////////////////////////
+class Polynomial
+{
+
+public:
+	enum Ring { CYCLIC, NEGACYCLIC };     // x^n - 1, x^n + 1
+
+	Polynomial();
+	Polynomial(NTT& ntt, Ring ring = NEGACYCLIC);    // zero polynomial of length ntt.vec_length
+	Polynomial(std::vector<BigUnsigned> coefficients, NTT& ntt, Ring ring = NEGACYCLIC);
+	static Polynomial fromEvaluation(std::vector<BigUnsigned> evaluation, NTT& ntt, Ring ring = NEGACYCLIC);
+
+	// Either form, transforming (once) if it is not held
+	const std::vector<BigUnsigned>& coefficients() const;
+	const std::vector<BigUnsigned>& evaluation() const;
+	BigUnsigned coefficient(int i) const;
+
+	// Mutators, the cached evaluation form is dropped
+	void setCoefficients(std::vector<BigUnsigned> coefficients);
+	void setCoefficient(int i, BigUnsigned value);
+
+	bool hasCoefficients() const { return coeffs_valid; }
+	bool hasEvaluation() const   { return evals_valid; }
+	int  size() const;
+	Ring ringType() const        { return ring; }
+
+	Polynomial operator*(const Polynomial& B) const;   // evaluation form only
+	Polynomial operator+(const Polynomial& B) const;
+	Polynomial operator-(const Polynomial& B) const;
+	Polynomial& operator*=(const Polynomial& B);
+	Polynomial& operator+=(const Polynomial& B);
+	Polynomial& operator-=(const Polynomial& B);
+	bool operator==(const Polynomial& B) const;        // same coefficients
+
+	// Sum of A[i] * B[i] in evaluation form, each coefficient reduced once
+	static Polynomial innerProduct(const std::vector<Polynomial>& A, const std::vector<Polynomial>& B);
+
+	// Ring inverse, pointwise in evaluation form with one batch_mod_inverse.
+	// It exists exactly when no evaluation is zero.
+	bool invertible() const;
+	Polynomial inverse() const;                        // evaluation form only
+
+	// a(X^k), in the forms this polynomial holds: an index permutation of
+	// the evaluation (NTT::automorphismMap), a permutation with sign flips
+	// of the coefficients. No transform either way.
+	Polynomial automorphism(int k) const;
+
+	// Transforms done by all polynomials so far (for tests and benchmarks)
+	static std::atomic<unsigned long> forward_transforms;
+	static std::atomic<unsigned long> inverse_transforms;
+
+	static bool polynomialTest(NTT& ntt, int n_tests);
+	static bool innerProductTest(NTT& ntt, int n_tests, int n_terms = 8);
+	static bool inverseTest(NTT& ntt, int n_tests);
+	static bool automorphismTest(NTT& ntt, int n_tests);
+
+private:
+	NTT* ntt;
+	Ring ring;
+
+	mutable std::vector<BigUnsigned> coeffs, evals;
+	mutable bool coeffs_valid, evals_valid;
+
+	void toEvaluation() const;
+	void toCoefficients() const;
+	bool compatible(const Polynomial& B, const char* op) const;
+	Polynomial combine(const Polynomial& B, bool subtract) const;
+};
@@ -144,8 +144,12 @@ bool REDC::test() {
 // Initialization parameters
 //////////////////////////////////////////////////////////////
 BigUnsigned REDC::findR(BigUnsigned mod) {
-	BigUnsigned R = 1;
 	// R should be greater, coprime with mod, and power of two 
+	// For odd mod every power of two is coprime, so that is the first one above mod.
+	if (mod.getBit(0))
+		return BigUnsigned(1) << mod.bitLength();
+
+	BigUnsigned R = 1;
 	while ( !(areCoprimes(R, mod) && R > mod)) {
 		R *= 2; 
 	}
@@ -1,13 +1,23 @@
 #include "RNS.h"
 #include <vector>
 #include "general_functions.h"
+#include "primality.h"
+#include "ParallelSearch.h"
+#include "ParameterCache.h"
 #include <iostream>
 #include "REDC.h"
 #include "BigIntLibrary/BigIntegerLibrary.hh"
 #include <string>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 
 using namespace std;
 
+// Vectors for temporaries that never leave the function. Taken from the
+// thread's ScratchArena when the caller has opened a ScratchArena::Scope.
+typedef vector<BigUnsigned, ScratchAllocator<BigUnsigned>> scratch_vector;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // RNS dynamic range given moduli
@@ -101,6 +111,64 @@ vector<vector<BigUnsigned>> RNS::hadamard_product_RNS(vector<vector<BigUnsigned>
 
     return Z;
 }
+
+//////////////////////////////////////////////////////////////////////////////
+// Modular inner product, sum over t of hadamard_product_RNS(A[t], B[t])
+
+// Per coefficient and channel the products of all pairs are added without
+// reduction (double width and growing) and reduced once, then a single
+// montgomeryReduce_RNS replaces one per term. The sum has to stay within
+// the bound of a single product, so more than maxInnerProductTerms() terms
+// are refused.
+///////////////////////////////////////////////////////////////////////////////
+// Inputs are taken to be below (k + 2) * M, the range modmult_RNS returns.
+// With MULTIPLY_MODMULT_INPUT_BY_D the sum itself comes out in base1, so it
+// has to stay below D1 (as in Bajard condition 3), otherwise below M * D1.
+BigUnsigned RNS::maxInnerProductTerms() {
+    BigUnsigned input_bound = M * (n_base1 + 2);
+    BigUnsigned range       = MULTIPLY_MODMULT_INPUT_BY_D ? D1 : M * D1;
+    return (range - 1) / (input_bound * input_bound);
+}
+
+vector<vector<BigUnsigned>> RNS::inner_product_RNS(const vector<vector<vector<BigUnsigned>>>& A, const vector<vector<vector<BigUnsigned>>>& B) {
+    vector<vector<BigUnsigned>> Z;
+
+    if (A.size() != B.size() || A.empty()) {
+        cout << "ERROR: RNS::inner_product_RNS needs the same number (at least one) of polynomials on both sides." << endl;
+        return Z;
+    }
+    if (maxInnerProductTerms() < A.size()) {
+        cout << "ERROR: RNS::inner_product_RNS accepts at most " << maxInnerProductTerms() << " terms for these bases, got " << A.size() << "." << endl;
+        return Z;
+    }
+
+    int length = A[0].size();
+    for (int t = 0; t < A.size(); t++) {
+        if (A[t].size() != length || B[t].size() != length) {
+            cout << "ERROR: RNS::inner_product_RNS requires polynomials of equal length." << endl;
+            return Z;
+        }
+    }
+
+    vector<BigUnsigned> X(total_bases);
+    BigUnsigned         sum;
+    Z.reserve(length);
+    for (int i = 0; i < length; i++) {
+        for (int c = 0; c < total_bases; c++) {
+            sum = 0;
+            for (int t = 0; t < A.size(); t++)
+                sum += A[t][i][c] * B[t][i][c];
+            X[c] = sum % bases[c];
+
+            // step 0 of modmult_RNS, once for the whole sum
+            if (MULTIPLY_MODMULT_INPUT_BY_D)
+                X[c].mulmod(X[c], D1_rns[c], bases[c]);
+        }
+        Z.push_back(montgomeryReduce_RNS(X));
+    }
+
+    return Z;
+}
 ///////////////////////////////////////////////////////////////////////////////
 // Returns values where the RNS sytem is 1|0|0, 0|1|0, 0|0|1, etc.
 
@@ -155,22 +223,24 @@ vector<BigUnsigned> RNS::forwardConverter(BigUnsigned num, vector<BigUnsigned> b
 ///////////////////////////////////////////////////////////////////////////////
 BigUnsigned RNS::reverseConverter(vector<BigUnsigned> num_RNS, vector<BigUnsigned> base) {
     //select weights to use
-    vector<BigUnsigned> weights;
+    vector<BigUnsigned> other_weights;
+    const vector<BigUnsigned>* weights_ptr = &other_weights;
     if (vectorsAreEqual(base, bases))
-        weights = weights_bases;
+        weights_ptr = &conversionWeights(RNS_WEIGHTS_BASES);
     else if (vectorsAreEqual(base, base1))
-        weights = weights_base1;
+        weights_ptr = &conversionWeights(RNS_WEIGHTS_BASE1);
     else if (vectorsAreEqual(base, base2))
-        weights = weights_base2;
+        weights_ptr = &conversionWeights(RNS_WEIGHTS_BASE2);
     else if (vectorsAreEqual(base, base2_with_mr))
-        weights = weights_base2_with_mr;
+        weights_ptr = &conversionWeights(RNS_WEIGHTS_BASE2_WITH_MR);
     else
-        weights = getConversionWeights(base);
+        other_weights = getConversionWeights(base);
+    const vector<BigUnsigned>& channel_weights = *weights_ptr;
 
     // Resolve conversion
     BigUnsigned ret_val = 0;
     for (int i = 0; i < base.size(); i++) {
-        ret_val += weights[i] * num_RNS[i];
+        ret_val += channel_weights[i] * num_RNS[i];
         ret_val %= getDynamicRange(base);
     }
 
@@ -181,15 +251,49 @@ BigUnsigned RNS::reverseConverter(vector<BigUnsigned> num_RNS, vector<BigUnsigne
 // Gets weights for the reverse RNS conversion
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::getConversionWeights(vector<BigUnsigned> base) {
-    vector<BigUnsigned> weights;
+    vector<BigUnsigned> channel_weights;
     BigUnsigned D = getDynamicRange(base);
 
     for (int i = 0; i < base.size(); i++) {
         BigUnsigned D_i = D / base[i];
         BigUnsigned D_i_inv_red_i = modinv(D_i, base[i]);
-        weights.push_back((D_i * D_i_inv_red_i) % D);     //int values of 1|0|0, 0|1|0, etc.
+        channel_weights.push_back((D_i * D_i_inv_red_i) % D);     //int values of 1|0|0, 0|1|0, etc.
     }
-    return weights;
+    return channel_weights;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Weights of bases, base1, base2 or base2_with_mr, built the first time they
+// are asked for (double-checked: threads that lose the race wait on the
+// table's mutex and then find it ready)
+///////////////////////////////////////////////////////////////////////////////
+const vector<BigUnsigned>& RNS::conversionWeights(RNSWeightTable table) {
+    LazyWeights& w = weights[table];
+    if (w.ready.load(memory_order_acquire))
+        return w.values;
+
+    lock_guard<mutex> guard(w.lock);
+    if (!w.ready.load(memory_order_relaxed)) {
+        switch (table) {
+            case RNS_WEIGHTS_BASES:         w.values = getConversionWeights(bases);         break;
+            case RNS_WEIGHTS_BASE1:         w.values = getConversionWeights(base1);         break;
+            case RNS_WEIGHTS_BASE2:         w.values = getConversionWeights(base2);         break;
+            case RNS_WEIGHTS_BASE2_WITH_MR: w.values = getConversionWeights(base2_with_mr); break;
+            default: break;
+        }
+        w.ready.store(true, memory_order_release);
+    }
+    return w.values;
+}
+
+// Builds the given tables now, e.g. before timing or before handing the object to threads
+void RNS::prepareWeights(vector<RNSWeightTable> tables) {
+    for (int i = 0; i < tables.size(); i++)
+        conversionWeights(tables[i]);
+}
+
+bool RNS::weightsReady(RNSWeightTable table) const {
+    return weights[table].ready.load(memory_order_acquire);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -293,7 +397,14 @@ starting with "pre-computed values".
  // all_bases holds the regular moduli (N), extended base (N), and redundant modulus (1). All coprime
  // needs called in main before using modmult()
  ///////////////////////////////////////////////////////////////////////////////
-void RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus) {
+bool RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus) {
+
+    // A configuration outside the Bajard bounds gives wrong modmults, so it is refused
+    // before anything is set (planBases finds one that fits).
+    if (!checkBases(moduli, montgomery_reduction_modulus, true)) {
+        cout << "ERROR: RNS bases refused for reduction modulus " << montgomery_reduction_modulus << "." << endl;
+        return false;
+    }
 
     /*
     all parameters are generated by knowing:
@@ -342,6 +453,10 @@ void RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomer
     // Redundant moduli (BigUnsigned)
     m_r = bases[total_bases - 1];
 
+    // conversion weights belong to the bases just set
+    for (int t = 0; t < RNS_N_WEIGHT_TABLES; t++)
+        weights[t].reset();
+
     // create montgomery or barrett reduction module for each channel
     for (int i = 0; i < total_bases; i++) {
         REDC redc_module(bases[i]);
@@ -364,31 +479,12 @@ void RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomer
     //Modulus inverse with respect to dynamic range
     M_inv = modinv(M, D1);
 
-    //check if input conditions are correct (k = n channels, M = reduction modulus, D =  dynamic range 1, D' = dynamic range 2)
-    int k = n_moduli;
-
-    BigUnsigned res1 = (M * (k + 2) * (k + 2));
-    BigUnsigned res2 = (M * (k + 2));
-    BigUnsigned res3 = (M*(k + 2)) * (M*(k + 2)); // (M * (base1[k - 1] * (k + 2)));
+    //input conditions (k = n channels, M = reduction modulus, D =  dynamic range 1, D' = dynamic range 2) were checked by checkBases
+    cout << "Bajard conditions met." << endl;
 
-    bool cond1 = res1 < D1;
-    bool cond2 = res2 < D2;
-    bool cond3 = res3 < D1; //res3 >= D1;
-
-    if (cond1 && cond2 && cond3)
-        cout << "Bajard conditions met." << endl;
-    if (!cond1) {
-        cout << "Bajard condition 1 not met: (M * (k + 2) * (k + 2)) < D1" << endl;
-        cout << "M,k, result < D1: " << M << " " << k << " " << res1 << " !< " << D1 << endl << endl;
-    }
-    if (!cond2) {
-        cout << "Bajard condition 2 not met: (M * (k + 2)) < D2" << endl;
-        cout << "M,k, result < D1: " << M << " " << k << " " << res2 << " !< " << D1 << endl << endl;
-    }
-    if (!cond3) {
-        cout << "Bajard condition 3 not met: (M * (base1[k-1] * (k + 2))) >= D1" << endl;
-        cout << "M,base1[k-1],k, result >= D1: " << M << " " << base1[k - 1] << " " << k << " " << res3 << " !>= " << D1 << endl << endl;
-    }
+    // everything below only depends on (bases, M); reuse it from an earlier run if possible
+    if (ParameterCache::load(*this))
+        return true;
 
     // D1 divided by the ith modulus (vector BigUnsigned)
     for (int i = 0; i < n_base1; i++) {
@@ -483,10 +579,7 @@ void RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomer
     }
     */
     // Base conversion weights (CANNOT combine into a single list of weights. Each of these are different.)
-    weights_bases = getConversionWeights(bases);
-    weights_base1 = getConversionWeights(base1);
-    weights_base2 = getConversionWeights(base2);
-    weights_base2_with_mr = getConversionWeights(base2_with_mr);
+    // They are built by conversionWeights on first use; prepareWeights builds them up front.
 
     /*
     // Base 2 conversion weights
@@ -498,6 +591,9 @@ void RNS::initializeParameters(vector<BigUnsigned> moduli, BigUnsigned montgomer
         /*IMPORTANT: This needs to be written this way, instead of being a copy of the base 1 weight code. The values here that depend on D2 are recalculated to include
         m_r in the dynamic range (because all other code besides the forward/reverse converter do not include m_r as one of the bases). */
         //}
+
+    ParameterCache::save(*this);
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -591,26 +687,28 @@ void RNS::savetotextParameters() {
  */
  ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::baseExtension1(vector<BigUnsigned> num_RNS, vector<BigUnsigned> base_in, vector<BigUnsigned> base_out) {
-    vector<BigUnsigned> sigma, num_RNS_new;
+    vector<BigUnsigned> num_RNS_new;
+    scratch_vector      sigma;
 
     int n_base_in = base_in.size(), n_base_out = base_out.size();
+    sigma.reserve(n_base_in);
+    num_RNS_new.reserve(n_base_out);
 
 
     // Calculate sigmas for each channel of the first base  
+    sigma.resize(n_base_in);
     for (int i = 0; i < n_base_in; i++) {                    //to be in parallel
-        sigma.push_back((num_RNS[i] * D1_i_inv_red_i[i]) % base_in[i]);
+        sigma[i].mulmod(num_RNS[i], D1_i_inv_red_i[i], base_in[i]);
     }
 
     //Compute each channel j of the new base + redundant channel (step 4)
     for (int j = 0; j < n_base_out; j++) { //in parallel //ONLY CONSTANT THAT IS N_CHANNELS + 1, for M_R OUTPUT
         BigUnsigned t = 0;
-        //accumulator, to occur on each channel
+        //accumulator, to occur on each channel (kept reduced)
         for (int i = 0; i < n_base_in; i++) {
-            t = (t + sigma[i] * D1_i_red_j[i][j]);
+            t.muladdmod(sigma[i], D1_i_red_j[i][j], t, base_out[j]);
         }
 
-        t %= base_out[j];
-
         //push accumulator result back and repeat for next channel
         num_RNS_new.push_back(t);
     }
@@ -689,14 +787,18 @@ Output is size n_moduli.
 
  // Shenoy base extension
 vector<BigUnsigned> RNS::baseExtension2(vector<BigUnsigned> A, vector<BigUnsigned> base_in, vector<BigUnsigned> base_out) {
-    vector<BigUnsigned> E_j, Z;
+    vector<BigUnsigned> Z;
+    scratch_vector      E_j;
     BigUnsigned beta;
 
     int n_base_in = base_in.size(), n_base_out = base_out.size();
+    E_j.reserve(n_base_out);
+    Z.reserve(n_base_out);
 
     //step 1
+    E_j.resize(n_base_out);
     for (int j = 0; j < n_base_out; j++) {
-        E_j.push_back((A[j] * D2_j_inv_red_j[j]) % base_in[j]); 
+        E_j[j].mulmod(A[j], D2_j_inv_red_j[j], base_in[j]); 
     }
 
     //step 2-4 (find t for m_r)
@@ -704,24 +806,24 @@ vector<BigUnsigned> RNS::baseExtension2(vector<BigUnsigned> A, vector<BigUnsigne
 
    // cout << "D2_J_RED_R: ";
     for (int j = 0; j < n_base_out; j++) {
-        t = (t + (E_j[j] * D2_j_red_r[j])); 
+        t.muladdmod(E_j[j], D2_j_red_r[j], t, m_r); 
     }
-    t %= m_r;
     
     //step 5 - only place (input mod m_r) is used! All loops dont use it
-    beta = (D2_inv_red_r * (t + m_r - A[n_base_in - 1]) % m_r) % m_r;  //in algorithm, r is the intermediate MM value and original input to shenoy
+    beta.submod(t, A[n_base_in - 1], m_r);
+    beta.mulmod(D2_inv_red_r, beta, m_r);  //in algorithm, r is the intermediate MM value and original input to shenoy
     
     //step 6-8 (find t for all j)
-    vector<BigUnsigned> t_i;
+    scratch_vector t_i;
+    t_i.reserve(n_base_out);
 
     for (int i = 0; i < n_base_out; i++) {      //performed in parallel
         t = 0;
         for (int j = 0; j < n_base_out; j++) {
-            t = (t + E_j[j] * D2_j_red_i[j][i]);     //BOTH ARE LENGTH N_CHANNELS, NOT INCLUDE M_R
+            t.muladdmod(E_j[j], D2_j_red_i[j][i], t, base_out[i]);     //BOTH ARE LENGTH N_CHANNELS, NOT INCLUDE M_R
 
            // printVal(D2_j_red_i[j][i], " ", false, true, 32);
         }
-        t %= base_out[i];
 
         t_i.push_back(t);
     }
@@ -733,8 +835,10 @@ vector<BigUnsigned> RNS::baseExtension2(vector<BigUnsigned> A, vector<BigUnsigne
     //{D2_j_red_i[j][0], D2_j_red_i[j][1], D2_j_red_i[j][2], D2_j_red_i[j][3]}
 
     //step 9
+    Z.resize(n_base_out);
     for (int i = 0; i < n_base_out; i++) { //in parallel
-        Z.push_back((t_i[i] + base_out[i] - (beta * D2_red_i[i]) % base_out[i]) % base_out[i]);
+        t.mulmod(beta, D2_red_i[i], base_out[i]);
+        Z[i].submod(t_i[i], t, base_out[i]);
     }
 
     //printVector(D2_red_i, "D2_RED_I: ", true, true, 32);
@@ -805,7 +909,9 @@ IMPORTANT: Requires inputs to be represented in both bases. They need to be the
 */
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::modmult_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B) {
-    vector<BigUnsigned> X, ans, Q_i, Q_j, Z_j, Z_i;
+    scratch_vector      X;
+
+    X.reserve(total_bases);
 
     //Operating conditions
        // 2*modulus less than dynamic range
@@ -821,22 +927,53 @@ vector<BigUnsigned> RNS::modmult_RNS(vector<BigUnsigned> A, vector<BigUnsigned>
     }
 
     // step 1
+    X.resize(total_bases);
     for (int i = 0; i < total_bases; i++) {
-        X.push_back((A[i] * B[i]) % bases[i]);
+        X[i].mulmod(A[i], B[i], bases[i]);
     }
 
+    // steps 2-5
+    return montgomeryReduce_RNS(X.data());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RNS montgomery reduction (steps 2-5 of modmult_RNS)
+
+// X holds a product (or a sum of products) in all bases, already reduced
+// per channel. Returns X * D1^-1 mod M, plus the same small multiples of M
+// as modmult_RNS, in base1 followed by base2 + m_r. X has to meet the same
+// bound as a single product (X < M * D1).
+///////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> RNS::montgomeryReduce_RNS(const vector<BigUnsigned>& X) {
+    if (X.size() != total_bases) {
+        cout << "ERROR: RNS::montgomeryReduce_RNS requires its input to be represented in both bases. (length != total_bases)" << endl;
+        return vector<BigUnsigned>();
+    }
+    return montgomeryReduce_RNS(X.data());
+}
+
+vector<BigUnsigned> RNS::montgomeryReduce_RNS(const BigUnsigned* X) {
+    vector<BigUnsigned> Q_i, Q_j, Z_j, Z_i;
+
+    Q_i.reserve(n_base1);
+    Z_j.reserve(n_base2_with_mr);
+
     // step 2 
+    const BigUnsigned zero;
+    Q_i.resize(n_base1);
     for (int i = 0; i < n_base1; i++) {                                            // IMPORTANT:
-        Q_i.push_back((base1[i] - (X[i] * M_inv_red_i[i]) % base1[i]) % base1[i]); // M_inv_red_i should be negative. This is the same as reducing the multiplication
-                                                                                   // and subtracting it from from base1[i] then reducing again.
+        Q_i[i].mulmod(X[i], M_inv_red_i[i], base1[i]);                             // M_inv_red_i should be negative. This is the same as reducing the multiplication
+        Q_i[i].submod(zero, Q_i[i], base1[i]);                                     // and subtracting it from from base1[i] then reducing again.
     }
 
     // step 3 
     Q_j = baseExtension1(Q_i, base1, base2_with_mr);
 
     //step 4
+    Z_j.resize(n_base2_with_mr);
     for (int j = 0; j < n_base2_with_mr; j++) {
-        Z_j.push_back(((X[j + n_base1] + Q_j[j] * M_red_j[j]) * D1_inv_red_j[j]) % base2_with_mr[j]); // ONLY MMULT LOOP TO NEED M_R
+        Z_j[j].muladdmod(Q_j[j], M_red_j[j], X[j + n_base1], base2_with_mr[j]);  // ONLY MMULT LOOP TO NEED M_R
+        Z_j[j].mulmod(Z_j[j], D1_inv_red_j[j], base2_with_mr[j]);
     }
 
     //step 5
@@ -969,7 +1106,7 @@ bool RNS::RNSmodmultTest(int n_tests) {
         }
 
         C_base1 = reverseConverter(C_rns, base1);
-        C_base2 = reverseConverter(C_rns, base2_with_mr);
+        C_base2 = reverseConverter(C_rns_base2, base2_with_mr);
 
         // correct answer
          if (MULTIPLY_MODMULT_INPUT_BY_D) {
@@ -1008,10 +1145,12 @@ bool RNS::RNSmodmultTest(int n_tests) {
             cout << "Base2 incorrect." << endl << endl;
         }
         if (ans == C_base1 && ans == C_base2) {
-            n_correct++;
             n_reduced_correct1++;
             n_reduced_correct2++;
         }
+        // modmult_RNS leaves a multiple of M unless CORRECT_MODMULT_OUTPUT is set
+        if (ans == C_base1 % M && ans == C_base2 % M)
+            n_correct++;
     }
 
     printVector(alpha, "Moduli offset for each non-reduced result: ", true);
@@ -1020,7 +1159,61 @@ bool RNS::RNSmodmultTest(int n_tests) {
     cout << n_reduced_correct1 << "/" << n_tests << " base1 correct if reduced." << endl;
     cout << n_reduced_correct2 << "/" << n_tests << " base2 correct if reduced." << endl;
     cout << n_correct << "/" << n_tests << " tests correct." << endl << endl;
-    return true;
+    return n_correct == n_tests;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RNS inner product test
+
+// Sums of n_terms products of random vectors (values below M, in all bases)
+// through inner_product_RNS, compared after reduction by M with the integer
+// sum, and timed against one hadamard_product_RNS per term.
+///////////////////////////////////////////////////////////////////////////////
+bool RNS::innerProductTest(int n_tests, int n_terms) {
+    cout << "----------- RNS inner product test (" << n_terms << " terms) ----------------" << endl;
+    int    n_correct = 0;
+    int    length    = 8;
+    double t_fused = 0, t_terms = 0;
+
+    BigUnsigned factor = MULTIPLY_MODMULT_INPUT_BY_D ? BigUnsigned(1) : modinv(D1, M);
+
+    for (int test = 0; test < n_tests; test++) {
+        vector<vector<vector<BigUnsigned>>> A_rns(n_terms), B_rns(n_terms);
+        vector<BigUnsigned> expected(length, BigUnsigned(0));
+
+        for (int t = 0; t < n_terms; t++) {
+            for (int i = 0; i < length; i++) {
+                BigUnsigned a = getRandomBigUnsigned(M);
+                BigUnsigned b = getRandomBigUnsigned(M);
+                A_rns[t].push_back(forwardConverter(a, bases));
+                B_rns[t].push_back(forwardConverter(b, bases));
+                expected[i] = (expected[i] + a * b) % M;
+            }
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        vector<vector<BigUnsigned>> Z = inner_product_RNS(A_rns, B_rns);
+        auto t1 = chrono::steady_clock::now();
+        vector<vector<BigUnsigned>> S = hadamard_product_RNS(A_rns[0], B_rns[0]);
+        for (int t = 1; t < n_terms; t++) {
+            vector<vector<BigUnsigned>> P = hadamard_product_RNS(A_rns[t], B_rns[t]);
+            for (int i = 0; i < length; i++)
+                S[i] = add_RNS(S[i], P[i], bases);
+        }
+        auto t2 = chrono::steady_clock::now();
+        t_fused += chrono::duration<double, milli>(t1 - t0).count();
+        t_terms += chrono::duration<double, milli>(t2 - t1).count();
+
+        bool correct = (Z.size() == length);
+        for (int i = 0; correct && i < length; i++)
+            correct = (reverseConverter(Z[i], base1) % M == (expected[i] * factor) % M);
+        if (correct)
+            n_correct++;
+    }
+
+    cout << "inner_product_RNS: " << t_fused << " ms, hadamard_product_RNS per term: " << t_terms << " ms." << endl;
+    cout << n_correct << "/" << n_tests << " tests correct." << endl << endl;
+    return n_correct == n_tests;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1036,8 +1229,10 @@ void RNS::butterflyRNStest(int n_tests) {
     int n_correct = 0;
     int l_correct = 0;
     int r_correct = 0;
+    unsigned long allocations = BigUnsigned::getAllocationCount();
 
     for (int i = 0; i < n_tests; i++) {
+        ScratchArena::Scope scratch;    // temporaries of this test are freed together
         cout << endl << endl << "RNS butterfly test: " << endl;
 
         BigUnsigned left  = getRandomBigUnsigned(M);
@@ -1081,9 +1276,12 @@ void RNS::butterflyRNStest(int n_tests) {
             cout << "Incorrect." << endl << endl;
     }
 
+    allocations = BigUnsigned::getAllocationCount() - allocations;
+
     cout << endl << l_correct << "/" << n_tests << " left tests correct." << endl;
     cout << endl << r_correct << "/" << n_tests << " right tests correct." << endl;
-    cout << endl << n_correct << "/" << n_tests << " tests correct." << endl << endl;
+    cout << endl << n_correct << "/" << n_tests << " tests correct." << endl;
+    cout << allocations << " BigUnsigned heap block allocations (" << allocations / n_tests << " per test)." << endl << endl;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1241,25 +1439,35 @@ bool RNS::bajardTest(int n_tests) {
 
 ///////////////////////////////////////////////////////////////////////////////
 // Modular arithmetic functions
+//
+// Use the fused BigUnsigned operations (no product or quotient temporaries,
+// single word arithmetic for channel moduli). MOD_SUB returns (A - B) mod MOD
+// for any A and B.
 ///////////////////////////////////////////////////////////////////////////////
-BigUnsigned RNS::MOD_ADD(BigUnsigned A, BigUnsigned B, BigUnsigned MOD) {
-    return (A + B) % MOD;
+BigUnsigned RNS::MOD_ADD(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD) {
+    BigUnsigned Z;
+    Z.addmod(A, B, MOD);
+    return Z;
 }
 
-BigUnsigned RNS::MOD_SUB(BigUnsigned A, BigUnsigned B, BigUnsigned MOD) {
-    return (A + MOD - B) % MOD;
+BigUnsigned RNS::MOD_SUB(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD) {
+    BigUnsigned Z;
+    Z.submod(A, B, MOD);
+    return Z;
 }
 
-BigUnsigned RNS::MOD_MULT(BigUnsigned A, BigUnsigned B, BigUnsigned MOD) {
-    return (A * B) % MOD;
+BigUnsigned RNS::MOD_MULT(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD) {
+    BigUnsigned Z;
+    Z.mulmod(A, B, MOD);
+    return Z;
 }
 ///////////////////////////////////////////////////////////////////////////////
 // Returns addition of RNS vectors 
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::add_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B, vector<BigUnsigned> base) {
-    vector<BigUnsigned> ret_val;
+    vector<BigUnsigned> ret_val(base.size());
     for (int i = 0; i < base.size(); i++) {
-        ret_val.push_back(MOD_ADD(A[i], B[i], base[i])); 
+        ret_val[i].addmod(A[i], B[i], base[i]);
     }
     return ret_val;
 }
@@ -1268,10 +1476,10 @@ vector<BigUnsigned> RNS::add_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B, v
 // Returns subtraction of RNS vectors 
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::sub_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B, vector<BigUnsigned> base) {
-    vector<BigUnsigned> ret_val;
+    vector<BigUnsigned> ret_val(base.size());
 
     for (int i = 0; i < base.size(); i++) {
-        ret_val.push_back(MOD_SUB(A[i], B[i], base[i]));
+        ret_val[i].submod(A[i], B[i], base[i]);
     }
 
     return ret_val;
@@ -1282,10 +1490,10 @@ vector<BigUnsigned> RNS::sub_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B, v
 // Returns multiplication of RNS vectors (no reduction or overflow protection)
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> RNS::mult_RNS(vector<BigUnsigned> A, vector<BigUnsigned> B, vector<BigUnsigned> base) {
-    vector<BigUnsigned> ret_val;
+    vector<BigUnsigned> ret_val(base.size());
 
     for (int i = 0; i < base.size(); i++) {
-        ret_val.push_back(MOD_MULT(A[i],B[i],base[i])); //standard RNS multiplication. Can be replaced with Barrett
+        ret_val[i].mulmod(A[i], B[i], base[i]); //standard RNS multiplication. Can be replaced with Barrett
     }
 
     return ret_val;
@@ -1369,44 +1577,303 @@ vector<BigUnsigned> RNS::determineRNSmoduli(int totalBits, int n_moduli) {
     return moduli;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Number of candidates start, start + step, ... below end (0 if none),
+// clamped to 64 bits for ParallelSearch::run
+/////////////////////////////////////////////////////////////////////////////
+static unsigned long long candidate_count(BigUnsigned start, BigUnsigned end, BigUnsigned step) {
+    if (start >= end)
+        return 0;
+    BigUnsigned count = (end - start + step - 1) / step;
+    return (count.bitLength() > 64) ? ~0ULL : to_u64(count);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Auto-generate RNS moduli 2 
 //
 //Get's coprime moduli in the form 2^k, 2^(k-1), and remaining all equal to 
 // the equally distributed bitdepth.
+//
+// The odd candidates are checked for coprimality in parallel against the
+// moduli accepted so far (n_found, published before each is used). The
+// ordered accept step only checks those accepted since, so the result is
+// the serial one.
 /////////////////////////////////////////////////////////////////////////////
 
 vector<BigUnsigned> RNS::determineRNSmoduli2(int totalBits, int n_moduli, bool generate_redundant_base) {
-    vector<BigUnsigned> moduli;
-
     int bitsPer = ceil(totalBits / n_moduli) + 1;
 
-    BigUnsigned mod = 1;
+    int n_mod = n_moduli;
+    //return twice as many moduli if needing a redundant base (plus redundant channel m_r)
+    if (generate_redundant_base) n_mod = n_moduli * 2 + 1;
+
+    // fixed size, so concurrent tests never see the vector itself change
+    vector<BigUnsigned> moduli(n_mod);
+    atomic<int> n_found(0);
 
     //First added modulus
+    BigUnsigned mod = 1;
     mod = mod << bitsPer;
-    moduli.push_back(mod);
+    moduli[0] = mod;
+    n_found = 1;
 
     //search all odd "bitsPer"-bit numbers
     BigUnsigned start = mod + 1;             //2^(bitsPer) + 1
     BigUnsigned end = mod << 1;            //2^(bitsPer+1) 
 
-    int n_mod = n_moduli;
-    //return twice as many moduli if needing a redundant base (plus redundant channel m_r)
-    if (generate_redundant_base) n_mod = n_moduli * 2 + 1;
+    // how many moduli each candidate was tested against, by k % window
+    unsigned long long window = ParallelSearch::windowSize();
+    vector<int> tested_against(window);
+
+    bool completed = (n_mod <= 1) || ParallelSearch::run(candidate_count(start, end, 2),
+        [&](unsigned long long k) {
+            BigUnsigned c = start + from_u64(2 * k);
+            int n = n_found.load();
+            tested_against[k % window] = n;
+            for (int i = 0; i < n; i++) {
+                if (!areCoprimes(c, moduli[i]))
+                    return false;
+            }
+            return true;
+        },
+        [&](unsigned long long k) {
+            BigUnsigned c = start + from_u64(2 * k);
+            int n = n_found.load();
+            for (int i = tested_against[k % window]; i < n; i++) {
+                if (!areCoprimes(c, moduli[i]))
+                    return true;
+            }
+            moduli[n] = c;
+            n_found = n + 1;
+            return n + 1 < n_mod;
+        });
 
-    for (mod = start; mod < end; mod += 2) {
-        if (isCoprimeToVector(mod, moduli)) {
-            moduli.push_back(mod);
+    moduli.resize(n_found);
+    if (moduli.size() < n_mod) {
+        if (!completed)
+            cout << "Moduli search cancelled." << endl;
+        cout << "Could not find " << n_moduli << " " << bitsPer << "-bit coprime numbers." << endl;
+    }
+    printModuliResults(totalBits, moduli, n_moduli);
+    return moduli;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// NTT-friendly prime moduli
+//
+// Returns n_primes distinct "bitwidth"-bit primes p = 1 mod 2n (n = vec_length),
+// so every channel can run its own negacyclic NTT. With near_power_of_two
+// the search goes down from 2^bitwidth, giving p = 2^bitwidth - c with c as
+// small as possible (cheap reduction), largest first. Otherwise it goes up
+// from 2^(bitwidth-1), smallest first.
+/////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> RNS::determineNTTprimes(int bitwidth, int n_primes, BigUnsigned vec_length, bool near_power_of_two) {
+    vector<BigUnsigned> primes;
+
+    BigUnsigned step = vec_length * 2;
+    BigUnsigned low  = BigUnsigned(1) << (bitwidth - 1);
+    BigUnsigned high = BigUnsigned(1) << bitwidth;
+
+    // candidate k is top - k*step (down, above low) or bottom + k*step (up, below high)
+    BigUnsigned top    = (high - 2) / step * step + 1;       // largest k*2n + 1 below 2^bitwidth
+    BigUnsigned bottom = (low - 1) / step * step + 1;        // smallest k*2n + 1 >= 2^(bitwidth-1)
+    if (bottom < low)
+        bottom += step;
+
+    auto candidate = [&](unsigned long long k) {
+        return near_power_of_two ? top - step * from_u64(k) : bottom + step * from_u64(k);
+    };
+    unsigned long long n_candidates = near_power_of_two ? ((top > low) ? candidate_count(low + 1, top + 1, step) : 0)
+                                                        : candidate_count(bottom, high, step);
+
+    bool completed = true;
+    if (n_primes > 0) {
+        completed = ParallelSearch::run(n_candidates,
+            [&](unsigned long long k) { return isPrime(candidate(k)); },
+            [&](unsigned long long k) { primes.push_back(candidate(k)); return primes.size() < n_primes; });
+    }
+
+    if (primes.size() < n_primes) {
+        if (!completed)
+            cout << "Prime search cancelled." << endl;
+        cout << "Could not find " << n_primes << " " << bitwidth << "-bit primes = 1 mod " << step << "." << endl;
+    }
+    return primes;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Everything initializeParameters needs from base1 | base2 | m_r and M:
+// an odd number (at least 3) of pairwise coprime moduli > 1, each coprime
+// to M (M^-1 and D1^-1 are taken mod D1 and M), and the Bajard conditions.
+// With print, every failed check is listed.
+/////////////////////////////////////////////////////////////////////////////
+bool RNS::checkBases(vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus, bool print) {
+    BigUnsigned M = montgomery_reduction_modulus;
+    vector<string> failed;
+
+    if (moduli.size() < 3 || moduli.size() % 2 == 0)
+        failed.push_back("need base1 | base2 | m_r: 2k + 1 moduli with k >= 1, got " + to_string(moduli.size()));
+    if (M < 2)
+        failed.push_back("reduction modulus must be at least 2");
+
+    for (int i = 0; i < moduli.size(); i++) {
+        if (moduli[i] < 2)
+            failed.push_back("modulus " + to_string(i) + " is below 2");
+        else if (M >= 2 && !areCoprimes(moduli[i], M))
+            failed.push_back("modulus " + to_string(i) + " shares a factor with M");
+        for (int j = 0; j < i; j++) {
+            if (moduli[i] >= 2 && moduli[j] >= 2 && !areCoprimes(moduli[i], moduli[j]))
+                failed.push_back("moduli " + to_string(j) + " and " + to_string(i) + " are not coprime");
         }
-        if (moduli.size() == n_mod) {
-            printModuliResults(totalBits, moduli, n_moduli);
+    }
+
+    if (failed.empty()) {
+        int k = (moduli.size() - 1) / 2;
+        BigUnsigned D1 = product(vector<BigUnsigned>(moduli.begin(), moduli.begin() + k));
+        BigUnsigned D2 = product(vector<BigUnsigned>(moduli.begin() + k, moduli.begin() + 2 * k));
+
+        if (!(M * (k + 2) * (k + 2) < D1))
+            failed.push_back("Bajard condition 1 not met: M * (k + 2)^2 < D1");
+        if (!(M * (k + 2) < D2))
+            failed.push_back("Bajard condition 2 not met: M * (k + 2) < D2");
+        if (!((M * (k + 2)) * (M * (k + 2)) < D1))
+            failed.push_back("Bajard condition 3 not met: (M * (k + 2))^2 < D1");
+        if (print && !failed.empty())
+            cout << "M, k, D1, D2: " << M << " " << k << " " << D1 << " " << D2 << endl;
+    }
+
+    if (print) {
+        for (int i = 0; i < failed.size(); i++)
+            cout << failed[i] << endl;
+    }
+    return failed.empty();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Fewest channels per base any choice of channel_bits-bit moduli can have:
+// D1 < 2^(channel_bits * k) and condition 3 needs (M * (k + 2))^2 < D1.
+/////////////////////////////////////////////////////////////////////////////
+int RNS::channelLowerBound(BigUnsigned montgomery_reduction_modulus, int channel_bits) {
+    BigUnsigned M = montgomery_reduction_modulus;
+    int k = 1;
+    while (!((M * (k + 2)) * (M * (k + 2)) < (BigUnsigned(1) << (channel_bits * k))))
+        k++;
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Smallest k with bitwidth-bit primes (= 1 mod 2n if vec_length is set, any
+// odd prime otherwise) for which base1 | base2 | m_r passes checkBases.
+// Primes dividing M are skipped. Empty if there are not enough primes.
+/////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> RNS::smallestBajardBases(BigUnsigned montgomery_reduction_modulus, int bitwidth, BigUnsigned vec_length, bool near_power_of_two, int min_moduli_per_base) {
+    BigUnsigned M = montgomery_reduction_modulus;
+    int M_bits = M.bitLength();
+
+    // each prime has more than bitwidth - 1 bits, so this many channels always suffice
+    int k_max = (2 * M_bits + 2 * 8) / (bitwidth - 1) + 2;
+    if (k_max < min_moduli_per_base)
+        k_max = min_moduli_per_base;
+
+    // vec_length 1 makes the step 2: every odd prime
+    BigUnsigned n = vec_length.isZero() ? BigUnsigned(1) : vec_length;
+    vector<BigUnsigned> primes = determineNTTprimes(bitwidth, 2 * k_max + 1, n, near_power_of_two);
+    primes.erase(remove_if(primes.begin(), primes.end(), [&](const BigUnsigned& p) { return (M % p).isZero(); }), primes.end());
+    sort(primes.begin(), primes.end(), [](const BigUnsigned& a, const BigUnsigned& b) { return a > b; });
+
+    int k = max(min_moduli_per_base, channelLowerBound(M, bitwidth));
+    for (; 2 * k + 1 <= primes.size(); k++) {
+        vector<BigUnsigned> moduli(primes.begin(), primes.begin() + 2 * k + 1);
+        if (checkBases(moduli, M))
             return moduli;
+    }
+    return vector<BigUnsigned>();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Word multiplies of one RNS modmult, in units of w^2: the products in all
+// 2k + 1 channels and the two base extensions, k * (k + 1) and k * k
+// channel terms. Roughly 2k^2 + 4k + 1.
+/////////////////////////////////////////////////////////////////////////////
+static unsigned long long modmultWork(int k, int channel_bits) {
+    unsigned long long w = channel_bits;
+    return (2ULL * k * k + 4ULL * k + 1) * w * w;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// RNS base planner
+//
+// Returns base1 | base2 | m_r for initializeParameters with the fewest
+// channels that pass checkBases for M, using primes of channel_bits bits
+// (RNS_MIN_CHANNELS), or of the width up to channel_bits with the least
+// modmultWork (RNS_MIN_WORK). With vec_length set, every prime is 1 mod 2n
+// so each channel can run its own NTT.
+//
+// k starts at channelLowerBound, which no w-bit base can beat, and every
+// k above it is tried in order, so the result has the fewest channels
+// possible with the largest w-bit primes. The chosen bases are checked
+// again before they are returned.
+/////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> RNS::planBases(BigUnsigned montgomery_reduction_modulus, int channel_bits, RNSObjective objective, BigUnsigned vec_length, int min_moduli_per_base) {
+    BigUnsigned M = montgomery_reduction_modulus;
+    BigUnsigned n = vec_length.isZero() ? BigUnsigned(1) : vec_length;
+
+    int min_bits = (objective == RNS_MIN_WORK) ? (int)(n * 2).bitLength() + 1 : channel_bits;
+
+    vector<BigUnsigned> best;
+    int best_bits = 0;
+    for (int w = channel_bits; w >= min_bits; w--) {
+        // about 2^(w-1) / (w ln 2 * n) w-bit primes are = 1 mod 2n; stop once
+        // narrower widths clearly cannot hold 2k + 1 of them
+        int k_lb = max(min_moduli_per_base, channelLowerBound(M, w));
+        if (w < channel_bits && w < 64 && (double)(1ULL << (w - 1)) / (w * 0.6931 * n.toUnsignedLong()) < 2 * (2 * k_lb + 1))
+            break;
+
+        vector<BigUnsigned> moduli = smallestBajardBases(M, w, vec_length, true, min_moduli_per_base);
+        if (moduli.empty())
+            break;
+        // narrower wins ties: less hardware per channel
+        int k = (moduli.size() - 1) / 2;
+        if (best.empty() || modmultWork(k, w) <= modmultWork((best.size() - 1) / 2, best_bits)) {
+            best      = moduli;
+            best_bits = w;
         }
     }
 
-    cout << "Could not find " << n_moduli << " " << bitsPer << "-bit coprime numbers." << endl;
-    printModuliResults(totalBits, moduli, n_moduli);
+    if (best.empty() || !checkBases(best, M, true)) {
+        cout << "ERROR: no RNS bases of up to " << channel_bits << " bits meet the Bajard conditions for a " << M.bitLength() << "-bit modulus." << endl;
+        return vector<BigUnsigned>();
+    }
+
+    int k = (best.size() - 1) / 2;
+    cout << "RNS plan: k = " << k << " (lower bound " << channelLowerBound(M, best_bits) << "), " << best.size() << " channels of " << best_bits << " bits";
+    cout << ", modmult work " << modmultWork(k, best_bits) << " bit^2." << endl;
+    printModuliResults(2 * M.bitLength(), best, k);
+    return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Full set of NTT-friendly moduli for initializeParameters
+//
+// Picks the smallest k for which base1 (k primes), base2 (k primes) and m_r
+// meet the Bajard conditions for reduction modulus M. The primes are handed
+// out largest first, so base1 gets the largest dynamic range (the tightest
+// condition, (M*(k+2))^2 < D1, is on D1) and m_r is the smallest.
+//
+// The conditions are for a single modmult. A whole RNS NTT with
+// MULTIPLY_MODMULT_INPUT_BY_D set needs more range (M = 673, n = 16 fails
+// below k = 3 with 32-bit channels), which min_moduli_per_base provides.
+/////////////////////////////////////////////////////////////////////////////
+vector<BigUnsigned> RNS::determineNTTmoduli(BigUnsigned montgomery_reduction_modulus, int bitwidth, BigUnsigned vec_length, bool near_power_of_two, int min_moduli_per_base) {
+    int M_bits = montgomery_reduction_modulus.bitLength();
+
+    vector<BigUnsigned> moduli = smallestBajardBases(montgomery_reduction_modulus, bitwidth, vec_length, near_power_of_two, min_moduli_per_base);
+    if (moduli.empty()) {
+        cout << "ERROR: not enough " << bitwidth << "-bit NTT primes to meet the Bajard conditions for a " << M_bits << "-bit modulus." << endl;
+        return moduli;
+    }
+
+    printModuliResults(2 * M_bits, moduli, (moduli.size() - 1) / 2);
     return moduli;
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include "REDC.h"
 #include "BigIntLibrary/BigIntegerLibrary.hh"
 
@@ -32,6 +34,43 @@ NOTE: int is now replaced with BigUnsigned
 
 */
 
+///////////////////////////////////////////////////////////////////////////////
+// What RNS::planBases optimizes
+//   RNS_MIN_CHANNELS: fewest channels at the given channel width
+//   RNS_MIN_WORK:     least total work, (2k+1) channels * w^2 per modmult,
+//                     over all widths w up to the given one. Narrower
+//                     channels win when the extra channels cost less.
+
+enum RNSObjective { RNS_MIN_CHANNELS, RNS_MIN_WORK };
+
+///////////////////////////////////////////////////////////////////////////////
+// Reverse conversion weights (int values of 1|0|0, 0|1|0, etc.) per base.
+// Each table is built by RNS::conversionWeights the first time it is needed,
+// so a workload that never reverse-converts in a base never pays for its
+// products and modinvs. Building is guarded by the table's own mutex; once
+// ready is set the values never change and are read without locking.
+
+enum RNSWeightTable { RNS_WEIGHTS_BASES, RNS_WEIGHTS_BASE1, RNS_WEIGHTS_BASE2, RNS_WEIGHTS_BASE2_WITH_MR, RNS_N_WEIGHT_TABLES };
+
+struct LazyWeights
+{
+        std::vector<BigUnsigned> values;
+        std::atomic<bool>        ready;
+        std::mutex               lock;
+
+        LazyWeights() : ready(false) {}
+        LazyWeights(const LazyWeights& other) : ready(false) { *this = other; }
+        LazyWeights& operator=(const LazyWeights& other) {   // copies a built table, otherwise starts empty
+            if (this != &other) {
+                bool built = other.ready.load(std::memory_order_acquire);
+                values = built ? other.values : std::vector<BigUnsigned>();
+                ready.store(built, std::memory_order_release);
+            }
+            return *this;
+        }
+        void reset() { values.clear(); ready.store(false); }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // class 
 
@@ -49,12 +88,12 @@ class RNS
         int                                      n_base1, n_base2, n_base2_with_mr, total_bases;   //number in each RNS base
         std::vector<BigUnsigned>                   base1,   base2, base2_with_mr,  bases;   //Bases of coprimes
    
-        std::vector<BigUnsigned> weights_base1, weights_base2, weights_base2_with_mr, weights_bases;   //int values of 1|0|0, 0|1|0, etc.
+        LazyWeights weights[RNS_N_WEIGHT_TABLES];   //conversion weights of bases, base1, base2, base2_with_mr (see conversionWeights)
         std::vector<REDC> redc;             //montgomery reduction function for each moduli
 
         //Initialization
         RNS();  
-        void initializeParameters(std::vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus);
+        bool initializeParameters(std::vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus);   // false (and nothing set) if checkBases fails
         void savetotextParameters();
 
         //Functions
@@ -62,12 +101,15 @@ class RNS
         std::vector<BigUnsigned> forwardConverter(BigUnsigned num, std::vector<BigUnsigned> base);
         BigUnsigned reverseConverter(std::vector<BigUnsigned> num_RNS, std::vector<BigUnsigned> base);
         std::vector<BigUnsigned> getConversionWeights(std::vector<BigUnsigned> base);
+        const std::vector<BigUnsigned>& conversionWeights(RNSWeightTable table);   // built on first use, thread safe
+        void prepareWeights(std::vector<RNSWeightTable> tables = { RNS_WEIGHTS_BASES, RNS_WEIGHTS_BASE1, RNS_WEIGHTS_BASE2, RNS_WEIGHTS_BASE2_WITH_MR });   // pre-warm
+        bool weightsReady(RNSWeightTable table) const;
         std::vector<std::vector<BigUnsigned>> RNS::forwardConverter_polynomial(std::vector<BigUnsigned> polynomial, std::vector<BigUnsigned> base);
         std::vector<BigUnsigned> RNS::reverseConverter_polynomial(std::vector<std::vector<BigUnsigned>> polynomial_rns, std::vector<BigUnsigned> base);
 
-        BigUnsigned MOD_ADD(BigUnsigned A, BigUnsigned B, BigUnsigned MOD);
-        BigUnsigned MOD_SUB(BigUnsigned A, BigUnsigned B, BigUnsigned MOD);
-        BigUnsigned MOD_MULT(BigUnsigned A, BigUnsigned B, BigUnsigned MOD);
+        BigUnsigned MOD_ADD(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD);
+        BigUnsigned MOD_SUB(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD);
+        BigUnsigned MOD_MULT(const BigUnsigned& A, const BigUnsigned& B, const BigUnsigned& MOD);
         std::vector<BigUnsigned> add_RNS(std::vector<BigUnsigned> A, std::vector<BigUnsigned> B, std::vector<BigUnsigned> base);
         std::vector<BigUnsigned> sub_RNS(std::vector<BigUnsigned> A, std::vector<BigUnsigned> B, std::vector<BigUnsigned> base);
         std::vector<BigUnsigned> mult_RNS(std::vector<BigUnsigned> A, std::vector<BigUnsigned> B, std::vector<BigUnsigned> base);
@@ -108,9 +150,11 @@ class RNS
         std::vector<BigUnsigned> baseExtension2(std::vector<BigUnsigned> num_RNS, std::vector<BigUnsigned> base, std::vector<BigUnsigned> newbase);
         
         std::vector<BigUnsigned> modmult_RNS(std::vector<BigUnsigned> A, std::vector<BigUnsigned> B);
+        std::vector<BigUnsigned> montgomeryReduce_RNS(const std::vector<BigUnsigned>& X);   // steps 2-5 of modmult_RNS
 
         void arithmetic_test(int n_tests);
         bool RNSmodmultTest(int n_tests);
+        bool innerProductTest(int n_tests, int n_terms = 8);
         bool baseExtensionTest(int n_tests);
         bool shenoyTest(int n_tests);
         bool bajardTest(int n_tests);
@@ -124,10 +168,21 @@ class RNS
         void printRNSval(std::vector<BigUnsigned> val_rns, std::vector<BigUnsigned> base = {}, bool printInIntform = false, std::string name = "");
         void printRNSvector(std::vector<std::vector<BigUnsigned>> list, std::string name = "",  std::vector<BigUnsigned> base = {}, bool printInIntform = true, bool printFullVector = false);
         std::vector<std::vector<BigUnsigned>> hadamard_product_RNS(std::vector<std::vector<BigUnsigned>> A, std::vector<std::vector<BigUnsigned>> B);
+        std::vector<std::vector<BigUnsigned>> inner_product_RNS(const std::vector<std::vector<std::vector<BigUnsigned>>>& A, const std::vector<std::vector<std::vector<BigUnsigned>>>& B);   // one reduction per coefficient
+        BigUnsigned maxInnerProductTerms();   // n_terms * ((k + 2) * M)^2 < D1 (M * D1 without MULTIPLY_MODMULT_INPUT_BY_D)
         std::vector<std::vector<BigUnsigned>> constant_vector_RNS(BigUnsigned length, BigUnsigned val, std::vector<BigUnsigned> base);
         static std::vector<BigUnsigned> determineRNSmoduli(int totalBits, int n_moduli);
         static std::vector<BigUnsigned> determineRNSmoduli2(int totalBits, int n_moduli, bool generate_redundant_base);
+        static std::vector<BigUnsigned> determineNTTprimes(int bitwidth, int n_primes, BigUnsigned vec_length, bool near_power_of_two = true);
+        static std::vector<BigUnsigned> determineNTTmoduli(BigUnsigned montgomery_reduction_modulus, int bitwidth, BigUnsigned vec_length, bool near_power_of_two = true, int min_moduli_per_base = 1);
+        static bool checkBases(std::vector<BigUnsigned> moduli, BigUnsigned montgomery_reduction_modulus, bool print = false);
+        static std::vector<BigUnsigned> planBases(BigUnsigned montgomery_reduction_modulus, int channel_bits, RNSObjective objective = RNS_MIN_CHANNELS, BigUnsigned vec_length = 0, int min_moduli_per_base = 1);
+        static int channelLowerBound(BigUnsigned montgomery_reduction_modulus, int channel_bits);
         static void printModuliResults(int totalBits, std::vector<BigUnsigned> moduli, int n_moduli = 4);
+    private:
+        std::vector<BigUnsigned> montgomeryReduce_RNS(const BigUnsigned* X);   // X holds total_bases residues
+        static std::vector<BigUnsigned> smallestBajardBases(BigUnsigned montgomery_reduction_modulus, int bitwidth, BigUnsigned vec_length, bool near_power_of_two, int min_moduli_per_base);
+    public:
         std::vector<BigUnsigned> butterfly(BigUnsigned left, BigUnsigned right, BigUnsigned twiddlefactor, BigUnsigned modulus);
         std::vector<std::vector<BigUnsigned>> butterfly_rns(std::vector<BigUnsigned> left, std::vector<BigUnsigned> right, std::vector<BigUnsigned> twiddlefactor);
 
@@ -0,0 +1,105 @@
+#include "StaticNTT.h"
+#include <iostream>
+#include <chrono>
+#include "NTT.h"
+#include "RNS.h"
+#include "ParameterCache.h"
+#include "general_functions.h"
+
+using namespace std;
+
+typedef static_ntt::word word;
+
+template<uint32_t N, uint64_t Q>
+static void benchmark_parameter_set(int n_runs) {
+	typedef StaticNTT<N, Q> SNTT;
+	typedef chrono::duration<double, micro> us;
+
+	cout << endl << "StaticNTT<" << N << ", " << Q << ">:" << endl;
+
+	// runtime parameter path: solveParameters and the phi table, cache off
+	bool cache = ParameterCache::enabled;
+	ParameterCache::enabled = false;
+	auto t0 = chrono::steady_clock::now();
+	NTT ntt(N, Q, RNS(), true);
+	auto t1 = chrono::steady_clock::now();
+	ParameterCache::enabled = cache;
+
+	bool same_params = (from_u64(SNTT::w_n) == ntt.w_n && from_u64(SNTT::phi) == ntt.phi && from_u64(SNTT::n_inv) == ntt.n_inv);
+
+	// identical output, forward and inverse
+	int n_tests   = 10;
+	int n_correct = 0;
+	for (int i = 0; i < n_tests; i++) {
+		vector<BigUnsigned> A = sample_polynomial(N, from_u64(Q));
+		vector<BigUnsigned> F = SNTT::calculate(A);
+		if (vectorsAreEqual(F, ntt.calculate(A)) && vectorsAreEqual(SNTT::calculate(F, true), ntt.calculate(F, true)))
+			n_correct++;
+	}
+
+	vector<BigUnsigned> A = sample_polynomial(N, from_u64(Q));
+	vector<word> a(N), b(N);
+	for (uint32_t i = 0; i < N; i++)
+		a[i] = to_u64(A[i]);
+
+	// BigUnsigned NTT
+	int big_runs = (n_runs / 10 > 0) ? n_runs / 10 : 1;
+	auto t2 = chrono::steady_clock::now();
+	for (int r = 0; r < big_runs; r++)
+		ntt.calculate(A);
+	auto t3 = chrono::steady_clock::now();
+
+	// word NTT with runtime parameters, tables built here
+	vector<word> twiddles(N / 2);
+	word q_inv = static_ntt::neg_inverse(Q);
+	word w_m   = static_ntt::to_montgomery(to_u64(ntt.w_n), Q);
+	twiddles[0] = static_ntt::to_montgomery(1, Q);
+	for (uint32_t i = 1; i < N / 2; i++)
+		twiddles[i] = static_ntt::mont_mul(twiddles[i - 1], w_m, Q, q_inv);
+
+	word check = 0;     // keeps the transforms from being optimized away
+	auto t4 = chrono::steady_clock::now();
+	for (int r = 0; r < n_runs; r++) {
+		b = a;
+		static_ntt::transform(b.data(), N, twiddles.data(), Q, q_inv);
+		check += b[r % N];
+	}
+	auto t5 = chrono::steady_clock::now();
+
+	// compile-time parameters
+	for (int r = 0; r < n_runs; r++) {
+		b = a;
+		SNTT::forward(b.data());
+		check += b[r % N];
+	}
+	auto t6 = chrono::steady_clock::now();
+
+	double t_ctor    = us(t1 - t0).count();
+	double t_big     = us(t3 - t2).count() / big_runs;
+	double t_runtime = us(t5 - t4).count() / n_runs;
+	double t_static  = us(t6 - t5).count() / n_runs;
+
+	cout << "Same w_n, phi, n_inv as NTT: " << (same_params ? "yes" : "NO") << endl;
+	cout << n_correct << "/" << n_tests << " tests correct." << endl;
+	cout << "NTT constructor (parameters and tables):  " << t_ctor << " us, StaticNTT: 0 (compile time)" << endl;
+	cout << "NTT::calculate (BigUnsigned):              " << t_big << " us" << endl;
+	cout << "word NTT, runtime parameters:              " << t_runtime << " us" << endl;
+	cout << "StaticNTT::forward:                        " << t_static << " us ("
+		<< t_runtime / t_static << "x runtime words, " << t_big / t_static << "x BigUnsigned)" << endl;
+	cout << "(checksum " << check << ")" << endl;
+}
+
+//////////////////////////////////////////////////////////////
+// What the runtime-parameter path costs. N stays at or below
+// 1024, where the tables build within MSVC's default
+// /constexpr:steps.
+//////////////////////////////////////////////////////////////
+void static_ntt_benchmark(int n_runs) {
+	cout << endl << endl << "StaticNTT benchmark (" << n_runs << " transforms per timing):" << endl;
+
+	benchmark_parameter_set<64, 12289>(n_runs);                    // unrolled
+	benchmark_parameter_set<256, 8380417>(n_runs);                 // Dilithium
+	benchmark_parameter_set<1024, 12289>(n_runs);                  // NewHope
+	benchmark_parameter_set<1024, 1152921504606830593ULL>(n_runs); // 60-bit prime
+	cout << endl;
+}
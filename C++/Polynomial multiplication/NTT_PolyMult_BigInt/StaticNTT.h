@@ -0,0 +1,371 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include <iostream>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#include "general_functions.h"
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////
+// NTT with compile-time parameters
+//
+// StaticNTT<N, Q> computes the same transform as NTT::calculate
+// (radix 2, bit reversed input, natural order output) for a fixed
+// power of two N and a prime Q < 2^63 with 2N | Q-1. Everything
+// the NTT constructor works out at run time is constexpr here:
+// the primality of Q, phi (the same search as
+// NTT::find_root_of_unity, so roots and output are identical),
+// w_n, the inverses, n^-1, the Montgomery constants, the twiddle
+// tables and the bit reversal permutation.
+//
+// For N <= UNROLL_LIMIT every butterfly is expanded at compile
+// time, with its indices and twiddle offset as constants. Larger
+// N get one loop nest per stage with constant bounds. Full
+// expansion only pays for small N: at 256 and 1024 the code no
+// longer fits the instruction cache and measured slower than the
+// loops (x86-64, gcc -O2), so the default limit is 64. Define
+// STATIC_NTT_UNROLL_LIMIT=1024 to expand everything up to 1024.
+//
+// Values are words < Q in normal form. Twiddles are stored in
+// Montgomery form (w * 2^64 mod Q), so one Montgomery product
+// gives x * w mod Q without converting the data.
+//
+// Building a table costs about 30 constexpr steps per entry, so
+// MSVC may need a larger /constexpr:steps for N >= 4096 (the
+// project file does not set one).
+//////////////////////////////////////////////////////////////
+namespace static_ntt {
+
+	typedef unsigned long long word;
+
+#ifndef STATIC_NTT_UNROLL_LIMIT
+#define STATIC_NTT_UNROLL_LIMIT 64
+#endif
+	static const uint32_t UNROLL_LIMIT = STATIC_NTT_UNROLL_LIMIT;
+
+	template<uint32_t SIZE> struct Table { word v[SIZE]; };
+	template<uint32_t SIZE> struct Permutation { uint32_t v[SIZE]; };
+
+	struct Wide { word lo, hi; };
+
+	// a * b as two words
+	constexpr Wide mul_wide(word a, word b) {
+#if defined(__SIZEOF_INT128__)
+		return Wide{ word((unsigned __int128)a * b), word(((unsigned __int128)a * b) >> 64) };
+#else
+		// 32 x 32 bit partial products, as in MontgomeryCIOS mulAdd
+		word aL = a & 0xffffffff, aH = a >> 32;
+		word bL = b & 0xffffffff, bH = b >> 32;
+		word ll = aL * bL, lh = aL * bH, hl = aH * bL, hh = aH * bH;
+		word mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+		return Wide{ (ll & 0xffffffff) | (mid << 32), hh + (lh >> 32) + (hl >> 32) + (mid >> 32) };
+#endif
+	}
+
+	// t * 2^-64 mod q for t < q * 2^64, q odd and below 2^63, q_inv = -q^-1 mod 2^64
+	constexpr word redc(Wide t, word q, word q_inv) {
+		word m = t.lo * q_inv;
+		// t + m*q is a multiple of 2^64; its low words carry exactly when t.lo != 0
+		word u = t.hi + mul_wide(m, q).hi + (t.lo != 0);
+		return (u >= q) ? u - q : u;
+	}
+
+	constexpr word mont_mul(word a, word b, word q, word q_inv) {
+		return redc(mul_wide(a, b), q, q_inv);
+	}
+
+	// Same as mont_mul, with the MSVC intrinsic where constexpr is not needed
+	inline word mont_mul_rt(word a, word b, word q, word q_inv) {
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+		word hi, mq_hi;
+		word lo = _umul128(a, b, &hi);
+		_umul128(lo * q_inv, q, &mq_hi);
+		word u = hi + mq_hi + (lo != 0);
+		return (u >= q) ? u - q : u;
+#else
+		return mont_mul(a, b, q, q_inv);
+#endif
+	}
+
+	// -q^-1 mod 2^64 by Newton iteration (q*q = 1 mod 8, each step doubles the correct bits)
+	constexpr word neg_inverse(word q) {
+		word x = q;
+		for (int i = 0; i < 5; i++)
+			x *= 2 - q * x;
+		return 0 - x;
+	}
+
+	// 2^128 mod q
+	constexpr word r_squared(word q) {
+		word r = (0 - q) % q;    // 2^64 mod q
+		for (int i = 0; i < 64; i++)
+			r = (r >= q - r) ? r - (q - r) : r + r;
+		return r;
+	}
+
+	constexpr word to_montgomery(word a, word q) {
+		return mont_mul(a % q, r_squared(q), q, neg_inverse(q));
+	}
+
+	constexpr word mul_mod(word a, word b, word q) {
+		return mont_mul(to_montgomery(a, q), b % q, q, neg_inverse(q));
+	}
+
+	constexpr word pow_mod(word base, word ex, word q) {
+		word q_inv = neg_inverse(q);
+		word b = to_montgomery(base, q);
+		word result = (0 - q) % q;       // 1 in Montgomery form
+		for (; ex != 0; ex >>= 1) {
+			if (ex & 1)
+				result = mont_mul(result, b, q, q_inv);
+			b = mont_mul(b, b, q, q_inv);
+		}
+		return redc(Wide{ result, 0 }, q, q_inv);
+	}
+
+	// a^-1 mod q for prime q
+	constexpr word inverse_mod(word a, word q) {
+		return pow_mod(a, q - 2, q);
+	}
+
+	// Deterministic Miller-Rabin, the bases of is_prime_u64
+	constexpr bool is_prime(word n) {
+		const word bases[12] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+		if (n < 2)
+			return false;
+		for (int i = 0; i < 12; i++) {
+			if (n % bases[i] == 0)
+				return n == bases[i];
+		}
+		word d = n - 1;
+		int s = 0;
+		while ((d & 1) == 0) {
+			d >>= 1;
+			s++;
+		}
+		for (int i = 0; i < 12; i++) {
+			word x = pow_mod(bases[i], d, n);
+			if (x == 1 || x == n - 1)
+				continue;
+			bool witness = true;
+			for (int r = 1; r < s && witness; r++) {
+				x = mul_mod(x, x, n);
+				if (x == n - 1)
+					witness = false;
+			}
+			if (witness)
+				return false;
+		}
+		return true;
+	}
+
+	// first a^((q-1)/order) of order exactly order (a power of two), from a = 2 up,
+	// as NTT::find_root_of_unity searches
+	constexpr word root_of_unity(word order, word q) {
+		for (word a = 2; a < q; a++) {
+			word root = pow_mod(a, (q - 1) / order, q);
+			if (pow_mod(root, order / 2, q) != 1)
+				return root;
+		}
+		return 0;
+	}
+
+	// powers w^0 .. w^(SIZE-1) in Montgomery form
+	template<uint32_t SIZE>
+	constexpr Table<SIZE> power_table(word w, word q) {
+		Table<SIZE> table{};
+		word q_inv = neg_inverse(q);
+		word w_m = to_montgomery(w, q);
+		word x = (0 - q) % q;
+		for (uint32_t i = 0; i < SIZE; i++) {
+			table.v[i] = x;
+			x = mont_mul(x, w_m, q, q_inv);
+		}
+		return table;
+	}
+
+	template<uint32_t SIZE>
+	constexpr Permutation<SIZE> bit_reversal() {
+		Permutation<SIZE> perm{};
+		for (uint32_t i = 0; i < SIZE; i++) {
+			uint32_t r = 0;
+			for (uint32_t bit = 1; bit < SIZE; bit <<= 1)
+				r = (r << 1) | ((i & bit) ? 1 : 0);
+			perm.v[i] = r;
+		}
+		return perm;
+	}
+
+	// Word NTT with run-time parameters: same butterflies and
+	// Montgomery twiddles as StaticNTT (twiddles[j] = w^j, j < n/2),
+	// but n, q and the tables are variables, so nothing is unrolled
+	// or folded into the code. In place on n words < q.
+	inline void transform(word* a, int n, const word* twiddles, word q, word q_inv) {
+		for (int i = 1, j = 0; i < n; i++) {
+			int bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				std::swap(a[i], a[j]);
+		}
+
+		for (int size = 2; size <= n; size += size) {
+			int halfsize  = size / 2;
+			int tablestep = n / size;
+			for (int i = 0; i < n; i += size) {
+				for (int j = 0; j < halfsize; j++) {
+					word& left  = a[i + j];
+					word& right = a[i + j + halfsize];
+					word product = mont_mul_rt(right, twiddles[j * tablestep], q, q_inv);
+					word sum     = left + product;
+					right = (left >= product) ? left - product : left + (q - product);
+					left  = (sum >= q) ? sum - q : sum;
+				}
+			}
+		}
+	}
+}
+
+template<uint32_t N, uint64_t Q>
+class StaticNTT
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "StaticNTT: N must be a power of two");
+	static_assert(Q % 2 == 1 && Q < (1ULL << 63), "StaticNTT: Q must be odd and below 2^63");
+	static_assert((Q - 1) % (2ULL * N) == 0, "StaticNTT: 2N must divide Q - 1");
+	static_assert(static_ntt::is_prime(Q), "StaticNTT: Q must be prime");
+
+public:
+	typedef static_ntt::word word;
+
+	static constexpr word modulus = Q;
+	static constexpr word phi     = static_ntt::root_of_unity(2ULL * N, Q);   // 2nth root of unity
+	static constexpr word phi_inv = static_ntt::inverse_mod(phi, Q);
+	static constexpr word w_n     = static_ntt::mul_mod(phi, phi, Q);        // nth root of unity
+	static constexpr word w_n_inv = static_ntt::inverse_mod(w_n, Q);
+	static constexpr word n_inv   = static_ntt::inverse_mod(N, Q);
+
+	// Montgomery constants
+	static constexpr word q_inv      = static_ntt::neg_inverse(Q);            // -Q^-1 mod 2^64
+	static constexpr word n_inv_mont = static_ntt::to_montgomery(n_inv, Q);
+
+	static constexpr static_ntt::Table<N / 2> forward_twiddles = static_ntt::power_table<N / 2>(w_n, Q);
+	static constexpr static_ntt::Table<N / 2> inverse_twiddles = static_ntt::power_table<N / 2>(w_n_inv, Q);
+	static constexpr static_ntt::Permutation<N> bit_reversal   = static_ntt::bit_reversal<N>();
+
+	// in place on N words < Q
+	static void forward(word* a) {
+		transform(a, forward_twiddles.v);
+	}
+
+	static void inverse(word* a) {
+		transform(a, inverse_twiddles.v);
+		for (uint32_t i = 0; i < N; i++)
+			a[i] = static_ntt::mont_mul_rt(a[i], n_inv_mont, Q, q_inv);
+	}
+
+	// NTT::calculate interface
+	static std::vector<BigUnsigned> calculate(std::vector<BigUnsigned> A, bool inverse = false) {
+		if (A.size() != N) {
+			std::cout << "ERROR: StaticNTT of length " << N << " called on " << A.size() << " values." << std::endl;
+			return A;
+		}
+
+		std::vector<word> a(N);
+		for (uint32_t i = 0; i < N; i++)
+			a[i] = to_u64(A[i] % Q);
+
+		if (inverse)
+			StaticNTT::inverse(a.data());
+		else
+			forward(a.data());
+
+		for (uint32_t i = 0; i < N; i++)
+			A[i] = from_u64(a[i]);
+		return A;
+	}
+
+private:
+	static inline void butterfly(word& left, word& right, word twiddle) {
+		word product = static_ntt::mont_mul_rt(right, twiddle, Q, q_inv);
+		word sum     = left + product;
+		right = (left >= product) ? left - product : left + (Q - product);
+		left  = (sum >= Q) ? sum - Q : sum;
+	}
+
+	static void transform(word* a, const word* twiddles) {
+		for (uint32_t i = 0; i < N; i++) {
+			uint32_t j = bit_reversal.v[i];
+			if (i < j)
+				std::swap(a[i], a[j]);
+		}
+		stages(a, twiddles, std::integral_constant<bool, (N <= static_ntt::UNROLL_LIMIT)>());
+	}
+
+	static void stages(word* a, const word* twiddles, std::true_type) {
+		stage<2>(a, twiddles, std::true_type());
+	}
+
+	// Loops for N > UNROLL_LIMIT, one instantiation per stage so the bounds are constants
+	static void stages(word* a, const word* twiddles, std::false_type) {
+		stage_loop<2>(a, twiddles, std::true_type());
+	}
+
+	template<uint32_t SIZE>
+	static void stage_loop(word* a, const word* twiddles, std::true_type) {
+		const uint32_t halfsize  = SIZE / 2;
+		const uint32_t tablestep = N / SIZE;
+		for (uint32_t i = 0; i < N; i += SIZE) {
+			for (uint32_t j = 0; j < halfsize; j++)
+				butterfly(a[i + j], a[i + j + halfsize], twiddles[j * tablestep]);
+		}
+		stage_loop<2 * SIZE>(a, twiddles, std::integral_constant<bool, (2 * SIZE <= N)>());
+	}
+
+	template<uint32_t SIZE>
+	static void stage_loop(word*, const word*, std::false_type) {}
+
+	// Unrolled: stage SIZE expands its N/2 butterflies, then instantiates stage 2*SIZE
+	template<uint32_t SIZE>
+	static inline void stage(word* a, const word* twiddles, std::true_type) {
+		butterflies<SIZE>(a, twiddles, std::make_index_sequence<N / 2>());
+		stage<2 * SIZE>(a, twiddles, std::integral_constant<bool, (2 * SIZE <= N)>());
+	}
+
+	template<uint32_t SIZE>
+	static inline void stage(word*, const word*, std::false_type) {}
+
+	template<uint32_t SIZE, std::size_t... I>
+	static inline void butterflies(word* a, const word* twiddles, std::index_sequence<I...>) {
+		int expand[] = { 0, (butterfly_at<SIZE, uint32_t(I)>(a, twiddles), 0)... };
+		(void)expand;
+	}
+
+	// butterfly I of stage SIZE: block I / halfsize, offset I % halfsize
+	template<uint32_t SIZE, uint32_t I>
+	static inline void butterfly_at(word* a, const word* twiddles) {
+		const uint32_t halfsize = SIZE / 2;
+		const uint32_t start    = I / halfsize * SIZE + I % halfsize;
+		butterfly(a[start], a[start + halfsize], twiddles[I % halfsize * (N / SIZE)]);
+	}
+};
+
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::modulus;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::phi;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::phi_inv;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::w_n;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::w_n_inv;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::n_inv;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::q_inv;
+template<uint32_t N, uint64_t Q> constexpr typename StaticNTT<N, Q>::word StaticNTT<N, Q>::n_inv_mont;
+template<uint32_t N, uint64_t Q> constexpr static_ntt::Table<N / 2> StaticNTT<N, Q>::forward_twiddles;
+template<uint32_t N, uint64_t Q> constexpr static_ntt::Table<N / 2> StaticNTT<N, Q>::inverse_twiddles;
+template<uint32_t N, uint64_t Q> constexpr static_ntt::Permutation<N> StaticNTT<N, Q>::bit_reversal;
+
+// Constructor + NTT::calculate versus StaticNTT for a few fixed parameter sets
+void static_ntt_benchmark(int n_runs = 100);
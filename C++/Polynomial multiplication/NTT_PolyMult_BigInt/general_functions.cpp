@@ -1,7 +1,11 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include "BigIntLibrary/BigIntegerLibrary.hh"
+#include "general_functions.h"
+#include "MontgomeryCIOS.h"
+#include "primality.h"
 #include <fstream>
 #include <iomanip>
 
@@ -32,11 +36,10 @@ BigUnsigned product(vector<BigUnsigned> vec) {
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// Returns random bigUnsigned of arbitrary size
+// Returns random bigUnsigned below range
 ///////////////////////////////////////////////////////////////////////////////
 BigUnsigned getRandomBigUnsigned(BigUnsigned range) {
     int BW = range.bitLength();
-    int n_32bits = BW / 32;
 
     BigUnsigned random;
 
@@ -44,10 +47,10 @@ BigUnsigned getRandomBigUnsigned(BigUnsigned range) {
         random = rand() % range.toInt();
 
     else {
-        random = rand() % (4294967294 / 2); //unsigned 31 bit value
-        for (int i = 0; i < n_32bits; i++) {
-            random *= random;
-        }
+        // 15 random bits at a time (RAND_MAX may be 32767), 15 more than range has
+        for (int bits = 0; bits < BW + 15; bits += 15)
+            random = (random << 15) + BigUnsigned(rand() & 0x7FFF);
+        random %= range;
     }
     return random;
 }
@@ -67,15 +70,51 @@ bool vectorsAreEqual(vector<BigUnsigned> a, vector<BigUnsigned> b) {
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// CIOS context for a modulus, so that hadamard_product and pow_mod do not
+// redo the n' and R^2 setup on every call (one call per product in the
+// NTT loops). Each thread keeps the last few moduli it used.
+///////////////////////////////////////////////////////////////////////////////
+static const MontgomeryCIOS& cached_cios(const BigUnsigned& mod) {
+    static const int CACHED_MODULI = 8;
+    static thread_local vector<MontgomeryCIOS> cache;
+    static thread_local int next = 0;
+
+    for (size_t i = 0; i < cache.size(); i++) {
+        if (cache[i].modulus == mod)
+            return cache[i];
+    }
+    if (cache.empty())
+        cache.reserve(CACHED_MODULI);     // references handed out stay valid
+    if (cache.size() < CACHED_MODULI) {
+        cache.push_back(MontgomeryCIOS(mod));
+        return cache.back();
+    }
+    MontgomeryCIOS& replaced = cache[next];
+    next = (next + 1) % CACHED_MODULI;
+    replaced = MontgomeryCIOS(mod);
+    return replaced;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Modular Hadamard Product
 // pointwise modular multiplication between vectors (to use RNS_mult function later)
+// Moduli wider than 64 bits use CIOS Montgomery multiplication.
 ///////////////////////////////////////////////////////////////////////////////
 vector<BigUnsigned> hadamard_product(vector<BigUnsigned> a, vector<BigUnsigned> b, BigUnsigned moduli) {
     vector<BigUnsigned> Z;
 
+    if (moduli.bitLength() > 64 && MontgomeryCIOS::supports(moduli)) {
+        const MontgomeryCIOS& cios = cached_cios(moduli);
+        for (int i = 0; i < a.size(); i++) {
+            Z.push_back(cios.modmult(a[i], b[i]));
+        }
+        return Z;
+    }
+
+    Z.resize(a.size());
     for (int i = 0; i < a.size(); i++) {
-        Z.push_back((a[i] * b[i]) % moduli);  //RNS_mod_multiply(a[i],b[i],moduli)
+        Z[i].mulmod(a[i], b[i], moduli);  //RNS_mod_multiply(a[i],b[i],moduli)
     }
 
     return Z;
@@ -145,73 +184,98 @@ vector<vector<BigUnsigned>> sample_RNS_polynomial(int length, vector<BigUnsigned
 
 ///////////////////////////////////////////////////////////////
 // Bit Reverse
-// Rearrange vector based on bit reversal of the indices
+// Rearrange vector based on bit reversal of the indices (N a power of two).
+// The reversed index j is carried from i to i + 1, and the pairs are
+// swapped in place, so no value is copied.
 ///////////////////////////////////////////////////////////////
 vector<BigUnsigned> bitReverse(vector<BigUnsigned> A) {
-    vector<BigUnsigned> Z = A; //return vector
-    int N = Z.size();
-    int n_bits = ceil(log2(N));
-
-    for (int i = 0; i < N; i++) {
-        int val = 0;
-        int idx = 0;
-        for (int j = 0; j < n_bits; j++) {
-            val = i & (1 << j); //A[i] --> i
-            if (val)
-                idx |= 1 << ((n_bits - 1) - j);
-        }
-        Z[i] = A[idx];
+    int N = A.size();
+
+    for (int i = 1, j = 0; i < N; i++) {
+        int bit = N >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            A[i].swap(A[j]);
     }
-    return Z;
+    return A;
 }
 
 // for vector vector types
 vector<vector<BigUnsigned>> bitReverse_rns(vector<vector<BigUnsigned>> A) {
-    vector<vector<BigUnsigned>> Z = A; //return vector
-    int N = Z.size();
-    int n_bits = ceil(log2(N));
-
-    for (int i = 0; i < N; i++) {
-        int val = 0;
-        int idx = 0;
-        for (int j = 0; j < n_bits; j++) {
-            val = i & (1 << j); //A[i] --> i
-            if (val)
-                idx |= 1 << ((n_bits - 1) - j);
-        }
-        Z[i] = A[idx];
+    int N = A.size();
+
+    for (int i = 1, j = 0; i < N; i++) {
+        int bit = N >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            A[i].swap(A[j]);
     }
-    return Z;
+    return A;
 }
 ///////////////////////////////////////////////////////////////
 // Factorize & isPrime
-// Returns a vector of prime factors of integer 
+// Returns a vector of prime factors of integer (with repeats, sorted).
+// Trial division up to 1000, then the cofactor is split with
+// Pollard rho until every piece passes the BPSW test.
 ///////////////////////////////////////////////////////////////
 vector<BigUnsigned> factorize(BigUnsigned n) {
     vector<BigUnsigned> factors;
+    if (n < 2)
+        return factors;
 
     //find number of 2s
-    while (n % 2 == 0) {
+    while (!n.getBit(0)) {
         factors.push_back(2);
-        n = n / 2;
+        n >>= 1;
     }
 
     //now n is odd
-    for (BigUnsigned i = 3; i <= n/2; i += 2) {  //sqrt(n) instead of n/2
-        while (n % i == 0) {
+    BigUnsigned r;
+    for (BigUnsigned i = 3; i < 1000 && i * i <= n; i += 2) {
+        while (true) {
+            r = n;
+            r %= i;
+            if (!r.isZero())
+                break;
             factors.push_back(i);
-            n = n / i;
+            n /= i;
+        }
+    }
+
+    //split what is left
+    vector<BigUnsigned> composites;
+    if (n > 1)
+        composites.push_back(n);
+    while (!composites.empty()) {
+        BigUnsigned c = composites.back();
+        composites.pop_back();
+        if (is_prime_bpsw(c)) {
+            factors.push_back(c);
+            continue;
         }
+        BigUnsigned d = pollard_brent(c);
+        composites.push_back(d);
+        composites.push_back(c / d);
     }
-    //if n is prime
-    if (n > 2)
-        factors.push_back(n);
 
+    sort(factors.begin(), factors.end());
     return factors;
 }
 
+// Distinct prime factors, e.g. for generator tests
+vector<BigUnsigned> prime_factors(BigUnsigned n) {
+    vector<BigUnsigned> factors = factorize(n);
+    factors.erase(unique(factors.begin(), factors.end()), factors.end());
+    return factors;
+}
+
+// Miller-Rabin / BPSW, see primality.cpp
 bool isPrime(BigUnsigned A) {
-    return(factorize(A).size() == 1);
+    return is_prime_bpsw(A);
 }
 
 ///////////////////////////////////////////////////////////////
@@ -235,14 +299,47 @@ BigUnsigned mod_inverse(BigUnsigned A, BigUnsigned mod) {
     */
 }
 
+///////////////////////////////////////////////////////////////
+// Batched modular inverse (Montgomery's trick)
+// Replaces every value by its inverse mod 'mod' with a single
+// mod_inverse and 3(n-1) modular products: prefix products up,
+// one inverse of the total, then peel one factor off per value.
+// Returns false (values unchanged) when some value is not a unit.
+///////////////////////////////////////////////////////////////
+bool batch_mod_inverse(vector<BigUnsigned>& values, BigUnsigned mod) {
+    if (values.empty())
+        return true;
+
+    vector<BigUnsigned> prefix(values.size());
+    prefix[0] = values[0] % mod;
+    for (int i = 1; i < values.size(); i++)
+        prefix[i] = (prefix[i - 1] * values[i]) % mod;
+
+    if (!areCoprimes(prefix.back(), mod))
+        return false;
+
+    BigUnsigned inv = mod_inverse(prefix.back(), mod);
+    for (int i = values.size() - 1; i > 0; i--) {
+        BigUnsigned value = values[i];
+        values[i] = (inv * prefix[i - 1]) % mod;
+        inv       = (inv * value) % mod;
+    }
+    values[0] = inv;
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////
 // Modular exponentiation (from wikipedia)
 
 // Can be replaced by:
 // modexp(const BigInteger& base, const BigUnsigned& exponent,const BigUnsigned& modulus)
+// Odd moduli wider than 64 bits use CIOS Montgomery multiplication.
 ///////////////////////////////////////////////////////////////
 BigUnsigned pow_mod(BigUnsigned base, BigUnsigned ex, BigUnsigned mod) {
    
+    if (mod.bitLength() > 64 && MontgomeryCIOS::supports(mod))
+        return cached_cios(mod).pow(base, ex);
+
     return modexp(base, ex, mod);
 
     /*
@@ -258,29 +355,220 @@ BigUnsigned pow_mod(BigUnsigned base, BigUnsigned ex, BigUnsigned mod) {
     */
     }
 
+///////////////////////////////////////////////////////////////
+// Conversions between BigUnsigned and 64-bit words
+// (BigUnsigned blocks are 32 bits with MSVC, 64 bits with gcc)
+// to_u64 keeps the low 64 bits.
+///////////////////////////////////////////////////////////////
+unsigned long long to_u64(const BigUnsigned& A) {
+    unsigned long long val = 0;
+    for (BigUnsigned::Index i = 0; i < A.getLength() && i * BigUnsigned::N < 64; i++)
+        val |= (unsigned long long)(A.getBlock(i)) << (i * BigUnsigned::N);
+    return val;
+}
+
+BigUnsigned from_u64(unsigned long long val) {
+    BigUnsigned A;
+    for (int i = (64 / BigUnsigned::N) - 1; i >= 0; i--)
+        A.setBlock(i, BigUnsigned::Blk(val >> (i * BigUnsigned::N)));
+    return A;
+}
+
 /////////////////////////////////////////////////////////////////
 // Multiply vector by powers of val
+// vec[i] * val^i, with a running power instead of a pow_mod per
+// coefficient (negative wrapped convolution scaling)
 ///////////////////////////////////////////////////////////////
 vector<BigUnsigned> mult_by_power(vector<BigUnsigned> vec, BigUnsigned val, BigUnsigned modulus) {
+    BigUnsigned power = 1;
     for (int i = 0; i < vec.size(); i++) {
-        vec[i] = (vec[i] * pow_mod(val, i, modulus)) % modulus;
+        vec[i] = (vec[i] * power) % modulus;
+        power  = (power * val) % modulus;
     }
 
     return vec;
 }
 
 ///////////////////////////////////////////////////////////////
-// Modular square root (stupid way) (Can do Tonelli - Shanks algorithm)
+// Modular square root, mod an odd prime
+//
+// Tonelli-Shanks: with mod - 1 = Q * 2^s it costs about
+// log2(mod) + s^2/2 multiplications, so for moduli with a large
+// power of two in mod - 1 Cipolla's algorithm (a fixed ~6 log2(mod)
+// multiplications in F_mod^2) is used instead. 64-bit moduli use
+// 1-word Montgomery arithmetic.
+//
+// Returns the smaller of the two roots, or 0 with an error if A is
+// not a square.
 ///////////////////////////////////////////////////////////////
+static void sqrt_mod_not_found(BigUnsigned A, BigUnsigned mod) {
+    cout << "No modular square root of " << A << " mod " << mod << " found. INCORRECT NUMBER RETURNED (0), CAUTION." << endl;
+}
+
+// (x0 + x1 w)(y0 + y1 w) with w^2 = w2, in place in x
+static void cipolla_mult(BigUnsigned& x0, BigUnsigned& x1, const BigUnsigned& y0, const BigUnsigned& y1, const BigUnsigned& w2, const BigUnsigned& mod) {
+    BigUnsigned t, r0, r1;
+    t.mulmod(x1, y1, mod);
+    t.mulmod(t, w2, mod);
+    r0.muladdmod(x0, y0, t, mod);
+    t.mulmod(x0, y1, mod);
+    r1.muladdmod(x1, y0, t, mod);
+    x0 = r0;
+    x1 = r1;
+}
+
+static BigUnsigned sqrt_mod_cipolla(const BigUnsigned& A, const BigUnsigned& mod) {
+    // a with a^2 - A a non-residue
+    BigUnsigned a = 1, w2;
+    while (true) {
+        w2.mulmod(a, a, mod);
+        w2.submod(w2, A, mod);
+        if (jacobi_symbol(w2, mod) == -1)
+            break;
+        a++;
+    }
+
+    // (a + w)^((mod + 1) / 2)
+    BigUnsigned ex = (mod + 1) >> 1;
+    BigUnsigned r0 = 1, r1 = 0;
+    for (int i = int(ex.bitLength()) - 1; i >= 0; i--) {
+        BigUnsigned s0 = r0, s1 = r1;
+        cipolla_mult(r0, r1, s0, s1, w2, mod);
+        if (ex.getBit(i))
+            cipolla_mult(r0, r1, a, 1, w2, mod);
+    }
+    return r0;
+}
+
+static BigUnsigned sqrt_mod_tonelli_shanks(const BigUnsigned& A, const BigUnsigned& mod, BigUnsigned Q, int s) {
+    // z a non-residue
+    BigUnsigned z = 2;
+    while (jacobi_symbol(z, mod) != -1)
+        z++;
+
+    int M = s;
+    BigUnsigned c = pow_mod(z, Q, mod);
+    BigUnsigned t = pow_mod(A, Q, mod);
+    BigUnsigned R = pow_mod(A, (Q + 1) >> 1, mod);
+    BigUnsigned b, t2;
+
+    while (t != 1) {
+        // least i with t^(2^i) = 1
+        int i = 0;
+        t2 = t;
+        while (t2 != 1) {
+            t2.mulmod(t2, t2, mod);
+            i++;
+        }
+
+        b = c;
+        for (int j = 0; j < M - i - 1; j++)
+            b.mulmod(b, b, mod);
+        M = i;
+        c.mulmod(b, b, mod);
+        t.mulmod(t, c, mod);
+        R.mulmod(R, b, mod);
+    }
+    return R;
+}
+
 BigUnsigned sqrt_mod(BigUnsigned A, BigUnsigned mod) {
-    for (BigUnsigned i = 0; i < mod; i++) {
-        if (pow_mod(i, 2, mod) == A)
-            return i;
-    }
-    //not found for (1331, 12289)
-    // error
-    cout << "No modular square root found. INCORRECT NUMBER RETURNED (-1), CAUTION." << endl;
-    return -1;
+    if (mod.bitLength() <= 64)
+        return from_u64(sqrt_mod_u64(to_u64(A % mod), to_u64(mod)));
+
+    A %= mod;
+    if (A.isZero())
+        return 0;
+    if (jacobi_symbol(A, mod) != 1) {
+        sqrt_mod_not_found(A, mod);
+        return 0;
+    }
+
+    BigUnsigned R;
+    if ((mod.getBlock(0) & 3) == 3) {
+        R = pow_mod(A, (mod + 1) >> 2, mod);
+    }
+    else {
+        // mod - 1 = Q * 2^s
+        BigUnsigned Q = mod - 1;
+        int s = 0;
+        while (!Q.getBit(s))
+            s++;
+        Q >>= s;
+
+        if (s * s > 8 * int(mod.bitLength()))
+            R = sqrt_mod_cipolla(A, mod);
+        else
+            R = sqrt_mod_tonelli_shanks(A, mod, Q, s);
+    }
+
+    BigUnsigned R2 = mod - R;
+    return (R2 < R) ? R2 : R;
+}
+
+// Tonelli-Shanks in the Montgomery domain (s <= 63, so no Cipolla needed)
+unsigned long long sqrt_mod_u64(unsigned long long A, unsigned long long mod) {
+    typedef MontgomeryCIOS::word word;
+
+    if (mod == 2 || A % mod == 0)
+        return A % mod;
+    A %= mod;
+    if (!(mod & 1) || jacobi_symbol(from_u64(A), from_u64(mod)) != 1) {
+        sqrt_mod_not_found(from_u64(A), from_u64(mod));
+        return 0;
+    }
+
+    MontgomeryCIOS mont(from_u64(mod));
+    auto pow = [&](word x, word ex) {
+        word r = mont.one[0];
+        for (int b = 63; b >= 0; b--) {
+            mont.mult(&r, &r, &r);
+            if ((ex >> b) & 1)
+                mont.mult(&r, &r, &x);
+        }
+        return r;
+    };
+
+    word Q = mod - 1;
+    int s = 0;
+    while (!(Q & 1)) {
+        Q >>= 1;
+        s++;
+    }
+
+    word z = 2;
+    while (jacobi_symbol(from_u64(z), from_u64(mod)) != -1)
+        z++;
+
+    word a = A;
+    mont.toMontgomery(&a, &a);
+    mont.toMontgomery(&z, &z);
+
+    int M = s;
+    word c = pow(z, Q);
+    word t = pow(a, Q);
+    word R = pow(a, (Q + 1) >> 1);
+    word b, t2;
+
+    while (t != mont.one[0]) {
+        int i = 0;
+        t2 = t;
+        while (t2 != mont.one[0]) {
+            mont.mult(&t2, &t2, &t2);
+            i++;
+        }
+
+        b = c;
+        for (int j = 0; j < M - i - 1; j++)
+            mont.mult(&b, &b, &b);
+        M = i;
+        mont.mult(&c, &b, &b);
+        mont.mult(&t, &t, &c);
+        mont.mult(&R, &R, &b);
+    }
+
+    mont.fromMontgomery(&R, &R);
+    return (mod - R < R) ? mod - R : R;
 }
 
 ///////////////////////////////////////////////////////////////
@@ -24,14 +24,20 @@ std::vector<BigUnsigned> bitReverse(std::vector<BigUnsigned> A);
 std::vector<std::vector<BigUnsigned>> bitReverse_rns(std::vector<std::vector<BigUnsigned>> A);
 
 std::vector<BigUnsigned> factorize(BigUnsigned n);
+std::vector<BigUnsigned> prime_factors(BigUnsigned n);
 
 std::vector<BigUnsigned> mult_by_power(std::vector<BigUnsigned> vec, BigUnsigned val, BigUnsigned modulus);
 
 BigUnsigned mod_inverse(BigUnsigned A, BigUnsigned mod);
+bool batch_mod_inverse(std::vector<BigUnsigned>& values, BigUnsigned mod);
 
 BigUnsigned pow_mod(BigUnsigned base, BigUnsigned ex, BigUnsigned mod);
 
 BigUnsigned sqrt_mod(BigUnsigned A, BigUnsigned mod);
+unsigned long long sqrt_mod_u64(unsigned long long A, unsigned long long mod);
+
+unsigned long long to_u64(const BigUnsigned& A);
+BigUnsigned from_u64(unsigned long long val);
 
 
 
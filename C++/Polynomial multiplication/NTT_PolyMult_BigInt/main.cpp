@@ -9,6 +9,17 @@
 #include "RNS.h"
 #include "NTT.h"
 #include "REDC.h"
+#include "MontgomeryCIOS.h"
+#include "primality.h"
+#include "ParameterCache.h"
+#include "ParameterCatalog.h"
+#include "StaticNTT.h"
+#include "ParallelSearch.h"
+#include "Polynomial.h"
+#include "PolyMatrix.h"
+#include "PolyMultiply.h"
+#include "MultiPrimeNTT.h"
+#include "Convolution.h"
 #include "BigIntLibrary/BigIntegerLibrary.hh"
 
 using namespace std;
@@ -236,20 +247,72 @@ int main()
     //barrett.modmultTest_barrett(100); 
     //return 0;
 
+    //MontgomeryCIOS cios((BigUnsigned(1) << 180) - 1);   // any odd modulus of 65-384 bits
+    //cios.modmultTest(1000);
+    //return 0;
+
+    //prime_search_benchmark();                         // time to find 30/60/120/180 bit NTT primes
+    //parallel_search_benchmark();                      // serial versus multi-threaded prime and moduli search
+    //ParallelSearch::threads = 1;                      // 0 = all cores
+    //return 0;
+
+    //ParameterCatalog::selfTest();                     // checks every precomputed parameter set, with an RNS NTT round trip each (minutes for n >= 4096)
+    //NTT ntt_catalog = NTT::fromCatalog("dilithium");  // n = 256, q = 8380417 without solveParameters
+    //ntt_catalog.NTT_test(10);
+    //return 0;
+
+    //static_ntt_benchmark();                           // NTT with compile-time n and q versus the NTT class
+    //return 0;
+
+    //PolyMultiplier::polyMultiplyTest(45);             // schoolbook, Karatsuba, Toom-3/4 and NTT agree, any q and n
+    //PolyMultiplier::calibrate(64, true, true);        // measured crossovers used by PolyMultiplier::multiply(..., POLYMULT_AUTO)
+    //poly_matrix_benchmark();                          // module-lattice matrix-vector products, ranks 2-4
+    //PolyMatrix::threads = 1;                          // 0 = all cores
+    //return 0;
+
+    //MultiPrimeNTT::multiPrimeTest(48);                // exact integer products, word NTTs per prime and Garner
+    //multi_prime_benchmark();                          // against one NTT over a prime above the coefficient bound
+    //return 0;
+
+    //Polynomial::inverseTest(ntt_catalog, 10);         // ring inverse, pointwise with one batched mod_inverse
+    //PolyMultiplier::seriesInverseTest(48);            // Newton inverse mod x^k, any modulus
+    //poly_inverse_benchmark();                         // n = 512 and 1024
+    //return 0;
+
+    //Polynomial::automorphismTest(ntt_catalog, 12);    // X -> X^k as an index permutation of the evaluation form
+    //return 0;
+
+    //PolyMultiplier::sparseMultiplyTest(40);           // ternary times dense by index lists, O(h n) additions
+    //sparse_multiply_benchmark();                      // against the NTT, h = 32 ... 256, n = 1024 ... 4096
+    //return 0;
+
+    //convolution_test(ntt_catalog, 10);                // multiply_cyclic / multiply_negacyclic, silent polynomial_multiply / negative_wrapped_convolution
+    //return 0;
+
+    //ntt_catalog.bitReversedTest(10);                  // bit reversed evaluations, plain / CIOS / RNS counted separately (dilithium passes all three)
+    //return 0;
+
     
+    //ParameterCache::enabled = true;   // reuse RNS/NTT parameters from *.cache files (off by default)
+    //ParameterCache::directory = "cache/";  // prefix for the files, "" = working directory
+
     //Calculates rns moduli, extended base, and m_r
     vector<BigUnsigned> bases;
     bases = {4294967291,4294967279,4294967231,4294967197,4294967189,4294967161,4294967143,4294967111, 4294967087}; //32 bit primes
     
     //bases = RNS::determineRNSmoduli2(dR_bits, n_moduli, true);
+    //bases = RNS::determineNTTmoduli(minimum_modulus, 32, length, true, 4);  // 32-bit primes = 1 mod 2n, 4 per base like the list above
+    //bases = RNS::planBases(minimum_modulus, 32, RNS_MIN_WORK);              // fewest/cheapest channels of up to 32 bits meeting the Bajard conditions
      
     RNS rns;                                         
-    rns.initializeParameters(bases,minimum_modulus); /*Instantiation creates an rns system that allow basic functions such as add/sub/mult, provided
+    if (!rns.initializeParameters(bases,minimum_modulus)) /*Instantiation creates an rns system that allow basic functions such as add/sub/mult, provided
                                                      a base with function calls. To generate internal variables and to use montgomery reduction,
                                                      the initializeParameters function needs called. It requires base1 (size n), base2 (size n), and
                                                      m_r (size 1) in a single vector. The moduli can be autogenerated using determineRNSmoduli2() or it 
                                                      can be taken from a prime number list. The second parameter is the reducion modulus for the NTT. 
+                                                     Bases outside the Bajard conditions are refused.
                                                      */
+        return 1;
 
     //rns.savetotextParameters();
     //printVector(rns.D1_i_red_j[0], "const: ", true, true, 32);
@@ -275,6 +338,7 @@ int main()
     rns.CORRECT_MODMULT_OUTPUT       = false;  // Reduce modmult output again to get fully reduced result  
     rns.CORRECT_BF_SUBTRACTION_INPUT = true;   // Decides whether to reduce input to butterfly subtraction (as that is the overflow problem)
 
+    //rns.innerProductTest(10);   //sums of products with one montgomery reduction per coefficient (inner_product_RNS)
     //rns.RNSmodmultTest(100);    //RNS montgomery reduction outputs answer + (k*n_moduli+2)M. Test for A*B or A*B*D^-1 depeneding on MULTIPLY_MODMULT_INPUT_BY_D flag.  
     rns.butterflyRNStest(100);    //Tests RNS butterfly:           100% accuracy if modmult is corrected.
     return 0;
@@ -293,6 +357,8 @@ int main()
 
     //ntt.CORRECT_LAST_NTT_RUN = true;// true; //enables CORRECT_MODMULT_OUTPUT on last stage of NTT
     //ntt.NTT_test(100);         //RNS NTT has 100% accuracy when compared to all other NTTs.
+    //Polynomial::polynomialTest(ntt, 20);   // products of Polynomial objects against schoolbook, fixed operands transformed once
+    //Polynomial::innerProductTest(ntt, 20); // sum of products, reduced once per coefficient and one inverse NTT
     
     return 0;
 
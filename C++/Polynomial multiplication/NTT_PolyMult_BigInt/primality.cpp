@@ -0,0 +1,386 @@
+#include "primality.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+#include "MontgomeryCIOS.h"
+#include "general_functions.h"
+#include "ParallelSearch.h"
+
+using namespace std;
+
+typedef MontgomeryCIOS::word word;
+
+//////////////////////////////////////////////////////////////
+// Trial division by the primes below 1000
+// returns 1 if n is prime, 0 if composite, -1 if undecided
+//////////////////////////////////////////////////////////////
+static vector<unsigned int> sieve_below_1000() {
+    vector<unsigned int> primes;
+    vector<bool> composite(1000, false);
+    for (unsigned int i = 2; i < 1000; i++) {
+        if (composite[i])
+            continue;
+        primes.push_back(i);
+        for (unsigned int j = i * i; j < 1000; j += i)
+            composite[j] = true;
+    }
+    return primes;
+}
+
+// initialized once, thread safe (the prime searches test candidates in parallel)
+static const vector<unsigned int>& small_primes() {
+    static const vector<unsigned int> primes = sieve_below_1000();
+    return primes;
+}
+
+static int trial_division(const BigUnsigned& n) {
+    if (n < 2)
+        return 0;
+
+    const vector<unsigned int>& primes = small_primes();
+    BigUnsigned p, r;
+    for (int i = 0; i < primes.size(); i++) {
+        p = primes[i];
+        if (n == p)
+            return 1;
+        r = n;
+        r %= p;
+        if (r.isZero())
+            return 0;
+    }
+    // no factor below 1000, so anything below 1000^2 is prime
+    return (n < 1000000) ? 1 : -1;
+}
+
+//////////////////////////////////////////////////////////////
+// Deterministic Miller-Rabin for 64-bit inputs
+//
+// The bases 2, 3, ..., 37 have no common strong pseudoprime
+// below 3.3 * 10^24 (Sorenson & Webster 2015), which covers
+// every 64-bit n. Arithmetic is 1-word CIOS Montgomery.
+//////////////////////////////////////////////////////////////
+bool is_prime_u64(unsigned long long n) {
+    static const word bases[12] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+    if (n < 2)
+        return false;
+    for (int i = 0; i < 12; i++) {
+        if (n % bases[i] == 0)
+            return n == bases[i];
+    }
+    if (n < 41 * 41)
+        return true;
+
+    // n - 1 = d * 2^s
+    word d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    MontgomeryCIOS mont(from_u64(n));
+    word minus_one = n - mont.one[0];    // -1 in Montgomery form
+
+    for (int i = 0; i < 12; i++) {
+        word x, a = bases[i];
+        mont.toMontgomery(&a, &a);
+
+        // x = a^d
+        x = mont.one[0];
+        for (int b = 63; b >= 0; b--) {
+            mont.mult(&x, &x, &x);
+            if ((d >> b) & 1)
+                mont.mult(&x, &x, &a);
+        }
+
+        if (x == mont.one[0] || x == minus_one)
+            continue;
+
+        bool witness = true;
+        for (int r = 1; r < s && witness; r++) {
+            mont.mult(&x, &x, &x);
+            if (x == minus_one)
+                witness = false;
+        }
+        if (witness)
+            return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////
+// Jacobi symbol (a/n) for odd n
+//////////////////////////////////////////////////////////////
+int jacobi_symbol(BigUnsigned a, BigUnsigned n) {
+    if (n.isZero() || !n.getBit(0)) {
+        cout << "ERROR: Jacobi symbol needs an odd n, got " << n << "." << endl;
+        return 0;
+    }
+
+    int result = 1;
+    a %= n;
+    while (!a.isZero()) {
+        int twos = 0;
+        while (!a.getBit(twos))
+            twos++;
+        a >>= twos;
+
+        // (2/n) = -1 when n = 3 or 5 mod 8
+        word n_mod8 = n.getBlock(0) & 7;
+        if ((twos & 1) && (n_mod8 == 3 || n_mod8 == 5))
+            result = -result;
+
+        // quadratic reciprocity
+        if ((a.getBlock(0) & 3) == 3 && (n.getBlock(0) & 3) == 3)
+            result = -result;
+        BigUnsigned t = n;
+        n = a;
+        a = t;
+        a %= n;
+    }
+    return (n == 1) ? result : 0;
+}
+
+//////////////////////////////////////////////////////////////
+// Perfect square test by integer Newton iteration
+//////////////////////////////////////////////////////////////
+bool is_perfect_square(BigUnsigned n) {
+    if (n < 2)
+        return true;
+
+    // x starts above sqrt(n) and decreases to floor(sqrt(n))
+    BigUnsigned x = BigUnsigned(1) << ((n.bitLength() + 1) / 2);
+    while (true) {
+        BigUnsigned y = (x + n / x) >> 1;
+        if (y >= x)
+            break;
+        x = y;
+    }
+    return x * x == n;
+}
+
+//////////////////////////////////////////////////////////////
+// Strong Lucas probable prime test (Selfridge parameters)
+//
+// D is the first of 5, -7, 9, -11, ... with (D/n) = -1,
+// P = 1 and Q = (1 - D) / 4. With n + 1 = d * 2^s, n passes
+// if U_d = 0 or V_(d*2^r) = 0 for some 0 <= r < s.
+// n must be odd, not a perfect square and have no small factor.
+//////////////////////////////////////////////////////////////
+static BigUnsigned signed_mod(long long a, const BigUnsigned& n) {
+    BigUnsigned r = from_u64(a < 0 ? word(-a) : word(a));
+    r %= n;
+    if (a < 0 && !r.isZero())
+        r = n - r;
+    return r;
+}
+
+// x / 2 mod n, n odd
+static void half_mod(BigUnsigned& x, const BigUnsigned& n) {
+    if (x.getBit(0))
+        x += n;
+    x >>= 1;
+}
+
+static bool is_strong_lucas_prp(const BigUnsigned& n) {
+    long long D = 5;
+    while (true) {
+        int j = jacobi_symbol(signed_mod(D, n), n);
+        if (j == -1)
+            break;
+        if (j == 0 && from_u64(D < 0 ? -D : D) != n)
+            return false;
+        D = (D > 0) ? -(D + 2) : -(D - 2);
+    }
+
+    BigUnsigned Dm = signed_mod(D, n);
+    BigUnsigned Qm = signed_mod((1 - D) / 4, n);
+
+    // n + 1 = d * 2^s
+    BigUnsigned d = n + 1;
+    int s = 0;
+    while (!d.getBit(s))
+        s++;
+    d >>= s;
+
+    // U_1 = 1, V_1 = P = 1, Qk = Q^1
+    BigUnsigned U = 1, V = 1, Qk = Qm, t;
+    for (int i = int(d.bitLength()) - 2; i >= 0; i--) {
+        // doubling: U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+        U.mulmod(U, V, n);
+        t.addmod(Qk, Qk, n);
+        V.mulmod(V, V, n);
+        V.submod(V, t, n);
+        Qk.mulmod(Qk, Qk, n);
+
+        if (d.getBit(i)) {
+            // U_2k+1 = (P U + V) / 2, V_2k+1 = (D U + P V) / 2
+            t.muladdmod(Dm, U, V, n);
+            U.addmod(U, V, n);
+            half_mod(U, n);
+            V = t;
+            half_mod(V, n);
+            Qk.mulmod(Qk, Qm, n);
+        }
+    }
+
+    if (U.isZero() || V.isZero())
+        return true;
+    for (int r = 1; r < s; r++) {
+        t.addmod(Qk, Qk, n);
+        V.mulmod(V, V, n);
+        V.submod(V, t, n);
+        if (V.isZero())
+            return true;
+        Qk.mulmod(Qk, Qk, n);
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////
+// Baillie-PSW
+//////////////////////////////////////////////////////////////
+bool is_prime_bpsw(BigUnsigned n) {
+    int td = trial_division(n);
+    if (td >= 0)
+        return td == 1;
+    if (n.bitLength() <= 64)
+        return is_prime_u64(to_u64(n));
+
+    // Miller-Rabin base 2
+    BigUnsigned n_minus_1 = n - 1;
+    int s = 0;
+    while (!n_minus_1.getBit(s))
+        s++;
+    BigUnsigned x = pow_mod(2, n_minus_1 >> s, n);
+    if (x != 1 && x != n_minus_1) {
+        bool witness = true;
+        for (int r = 1; r < s && witness; r++) {
+            x.mulmod(x, x, n);
+            if (x == n_minus_1)
+                witness = false;
+        }
+        if (witness)
+            return false;
+    }
+
+    if (is_perfect_square(n))
+        return false;
+    return is_strong_lucas_prp(n);
+}
+
+//////////////////////////////////////////////////////////////
+// Pollard rho with Brent's cycle detection
+//
+// Iterates y -> y^2 + c mod n and accumulates the differences
+// |x - y| into one product q, so that a gcd is only needed every
+// m steps. If a batch overshoots (gcd = n), it is replayed one
+// step at a time; if that fails too, c is changed.
+//////////////////////////////////////////////////////////////
+BigUnsigned pollard_brent(BigUnsigned n) {
+    const int m = 128;
+
+    if (!n.getBit(0))
+        return 2;
+
+    for (BigUnsigned c = 1; c < n; c++) {
+        BigUnsigned x, y = 2, ys, q = 1, diff, g = 1;
+        unsigned long r = 1;
+
+        while (g == 1) {
+            x = y;
+            for (unsigned long i = 0; i < r; i++)
+                y.muladdmod(y, y, c, n);
+
+            for (unsigned long k = 0; k < r && g == 1; k += m) {
+                ys = y;
+                for (unsigned long i = 0; i < m && i < r - k; i++) {
+                    y.muladdmod(y, y, c, n);
+                    diff.submod(x, y, n);
+                    q.mulmod(q, diff, n);
+                }
+                g = gcd(q, n);
+            }
+            r *= 2;
+        }
+
+        if (g == n) {
+            do {
+                ys.muladdmod(ys, ys, c, n);
+                diff.submod(x, ys, n);
+                g = gcd(diff, n);
+            } while (g == 1);
+        }
+
+        if (g != n)
+            return g;
+    }
+
+    cout << "ERROR: Pollard rho found no factor of " << n << "." << endl;
+    return n;
+}
+
+//////////////////////////////////////////////////////////////
+// Prime search
+// The candidates start + k*step are tested in parallel
+// (ParallelSearch); the first prime in k order is returned, so
+// the result does not depend on the thread count. 0 if the
+// search is cancelled.
+//////////////////////////////////////////////////////////////
+static BigUnsigned first_prime(const BigUnsigned& start, const BigUnsigned& step) {
+    BigUnsigned p = 0;
+    bool completed = ParallelSearch::run(~0ULL,
+        [&](unsigned long long k) { return isPrime(start + step * from_u64(k)); },
+        [&](unsigned long long k) { p = start + step * from_u64(k); return false; });
+
+    if (!completed)
+        cout << "Prime search from " << start << " cancelled." << endl;
+    return p;
+}
+
+BigUnsigned next_prime(BigUnsigned n) {
+    if (n <= 2)
+        return 2;
+    if (!n.getBit(0))
+        n++;
+    return first_prime(n, 2);
+}
+
+BigUnsigned next_ntt_prime(BigUnsigned min_modulus, BigUnsigned step) {
+    if (step.isZero()) {
+        cout << "ERROR: NTT prime search needs a nonzero step." << endl;
+        return 0;
+    }
+
+    // smallest k*step + 1 >= min_modulus
+    BigUnsigned p = (min_modulus.isZero()) ? 1 : (min_modulus - 1) / step * step + 1;
+    if (p < min_modulus)
+        p += step;
+    return first_prime(p, step);
+}
+
+//////////////////////////////////////////////////////////////
+// Time to find an NTT prime of each size
+//////////////////////////////////////////////////////////////
+void prime_search_benchmark(BigUnsigned vec_length) {
+    int sizes[4] = { 30, 60, 120, 180 };
+
+    cout << endl << endl << "Prime search benchmark (p = 1 mod " << vec_length << "):" << endl;
+
+    for (int i = 0; i < 4; i++) {
+        BigUnsigned min_modulus = BigUnsigned(1) << (sizes[i] - 1);
+
+        auto t0 = chrono::steady_clock::now();
+        BigUnsigned p = next_ntt_prime(min_modulus, vec_length);
+        auto t1 = chrono::steady_clock::now();
+        BigUnsigned q = next_prime(min_modulus);
+        auto t2 = chrono::steady_clock::now();
+
+        cout << endl << sizes[i] << " bits:" << endl;
+        cout << "next_ntt_prime: " << p << " in " << chrono::duration_cast<chrono::microseconds>(t1 - t0).count() << " us." << endl;
+        cout << "next_prime:     " << q << " in " << chrono::duration_cast<chrono::microseconds>(t2 - t1).count() << " us." << endl;
+    }
+    cout << endl;
+}
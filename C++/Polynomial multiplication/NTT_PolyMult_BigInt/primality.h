@@ -0,0 +1,34 @@
+#pragma once
+#include "BigIntLibrary/BigIntegerLibrary.hh"
+
+//////////////////////////////////////////////////////////////
+// Primality tests and prime search
+//
+// is_prime_u64 is deterministic Miller-Rabin with the first 12
+// prime bases, which has no pseudoprimes below 2^64.
+// is_prime_bpsw is Baillie-PSW (Miller-Rabin base 2 followed by
+// a strong Lucas test). No BPSW pseudoprime is known, and none
+// exist below 2^64.
+//
+// is_prime_bpsw hands 64-bit inputs to is_prime_u64, so it is
+// exact there. isPrime() (general_functions.h) is is_prime_bpsw.
+//////////////////////////////////////////////////////////////
+
+bool is_prime_u64(unsigned long long n);
+bool is_prime_bpsw(BigUnsigned n);
+
+int jacobi_symbol(BigUnsigned a, BigUnsigned n);
+bool is_perfect_square(BigUnsigned n);
+
+// a nontrivial factor of composite n (Pollard rho, Brent's cycle
+// detection). n should be odd with no small factors.
+BigUnsigned pollard_brent(BigUnsigned n);
+
+// smallest prime >= n
+BigUnsigned next_prime(BigUnsigned n);
+// smallest prime p >= min_modulus with p = 1 mod step, so an NTT of
+// length step (or any divisor of it) exists mod p.
+// Both return 0 if ParallelSearch::cancel() stops the search.
+BigUnsigned next_ntt_prime(BigUnsigned min_modulus, BigUnsigned step);
+
+void prime_search_benchmark(BigUnsigned vec_length = 8192);